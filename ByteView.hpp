@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+// Read-only bytes owned elsewhere, like C++20's std::span<const uint8_t>
+class ByteView
+{
+    const uint8_t* data_=nullptr;
+    std::size_t size_=0;
+public:
+    ByteView()=default;
+    ByteView(const uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+    ByteView(std::vector<uint8_t> const& data) : data_(data.data()), size_(data.size()) {}
+
+    const uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_==0; }
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_+size_; }
+    uint8_t operator[](std::size_t i) const { return data_[i]; }
+    uint8_t at(std::size_t i) const
+    {
+        if(i>=size_) throw std::out_of_range("ByteView::at");
+        return data_[i];
+    }
+};
+
+// Where a blob is within the byte buffer of its owner. Unlike a view, it
+// stays valid when the owner is copied.
+struct ByteRange
+{
+    uint32_t offset;
+    uint32_t size;
+};
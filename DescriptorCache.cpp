@@ -0,0 +1,297 @@
+#include "DescriptorCache.h"
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+
+using Endpoint=DeviceInfo::Endpoint;
+
+enum DescriptorType
+{
+    DT_DEVICE=1,
+    DT_CONFIG=2,
+    DT_INTERFACE=4,
+    DT_ENDPOINT=5,
+};
+
+unsigned getLE16(const uint8_t*const data)
+{
+    return data[0] | data[1]<<8;
+}
+
+QString formatRevision(const unsigned revBCD)
+{
+    if(revBCD&0xf000)
+    {
+        return QString("%1%2.%3%4").arg(QChar((revBCD>>12)+'0')).arg(QChar((revBCD>>8&0xf)+'0'))
+                                   .arg(QChar((revBCD>>4&0xf)+'0')).arg(QChar((revBCD&0xf)+'0'));
+    }
+    return QString("%1.%2%3").arg(QChar((revBCD>>8&0xf)+'0')).arg(QChar((revBCD>>4&0xf)+'0')).arg(QChar((revBCD&0xf)+'0'));
+}
+
+void decodeEndpoint(const uint8_t*const desc, const double speed, Endpoint& ep)
+{
+    // The strings and the interval are formatted the way linux-4.14.157/core/endpoint.c shows them in sysfs
+    ep.address=desc[2];
+    ep.attributes=desc[3];
+    ep.maxPacketSize=getLE16(desc+4);
+    const unsigned bInterval=std::min(desc[6], uint8_t(16));
+
+    const bool highSpeed = speed==480;
+    const bool highSpeedOrFaster = speed>=480;
+    const bool dirIn = ep.address&0x80;
+    unsigned interval=0;
+    switch(ep.attributes&3)
+    {
+    case 0:
+        ep.type=Endpoint::Type::Control;
+        ep.direction=Endpoint::Direction::Both;
+        if(highSpeed) interval=bInterval; // microframes per NAK
+        break;
+    case 1:
+        ep.type=Endpoint::Type::Isochronous;
+        if(bInterval) interval=1u<<(bInterval-1);
+        break;
+    case 2:
+        ep.type=Endpoint::Type::Bulk;
+        if(highSpeed && !dirIn) interval=bInterval; // microframes per NAK
+        break;
+    case 3:
+        ep.type=Endpoint::Type::Interrupt;
+        if(!highSpeedOrFaster)
+            interval=desc[6];
+        else if(bInterval)
+            interval=1u<<(bInterval-1);
+        break;
+    }
+    if(ep.type!=Endpoint::Type::Control)
+        ep.direction = dirIn ? Endpoint::Direction::In : Endpoint::Direction::Out;
+
+    interval *= highSpeedOrFaster ? 125 : 1000;
+    if(interval%1000)
+    {
+        ep.intervalBetweenTransfers=interval;
+        ep.intervalUnit=Endpoint::IntervalUnit::Microseconds;
+    }
+    else
+    {
+        ep.intervalBetweenTransfers=interval/1000;
+        ep.intervalUnit=Endpoint::IntervalUnit::Milliseconds;
+    }
+}
+
+void decode(DecodedDescriptors& decoded, const double speed)
+{
+    // Malformed descriptors are skipped, and the rest of the data is decoded if its framing allows
+    const auto& data=decoded.data;
+    const auto bad=[&decoded](std::string const& what)
+    {
+        decoded.diagnostics.push_back(QString::fromStdString("Bad descriptor: "+what));
+    };
+    if(data.empty())
+    {
+        bad("no descriptors");
+        return;
+    }
+
+    bool haveDeviceDescriptor=false;
+    DeviceInfo::Config* config=nullptr;
+    DeviceInfo::Interface* iface=nullptr;
+    for(unsigned off=0; off<data.size();)
+    {
+        const unsigned len=data[off];
+        if(len<2)
+        {
+            bad("length at offset "+std::to_string(off)+" is too small");
+            break;
+        }
+        if(data.size() < off+len)
+        {
+            bad("length at offset "+std::to_string(off)+" overflows data size");
+            break;
+        }
+        const auto desc=data.data()+off;
+        decoded.rawDescriptors.push_back({off, len});
+        const auto tooShort=[&bad, off](const char* type)
+            { bad(std::string(type)+" descriptor at offset "+std::to_string(off)+" is too short"); };
+        off+=len;
+
+        // Field offsets are defined in USB 2.0 spec, chapter 9.6
+        switch(desc[1])
+        {
+        case DT_DEVICE:
+        {
+            if(len<18)
+            {
+                tooShort("device");
+                break;
+            }
+            const auto bcdUSB=getLE16(desc+2);
+            decoded.usbVersion=QString("%1.%2").arg(bcdUSB>>8, 0, 16).arg(bcdUSB&0xff, 2, 16, QChar('0'));
+            decoded.devClass=desc[4];
+            decoded.devSubClass=desc[5];
+            decoded.devProtocol=desc[6];
+            decoded.maxPacketSize=desc[7];
+            decoded.vendorId=getLE16(desc+8);
+            decoded.productId=getLE16(desc+10);
+            decoded.revision=formatRevision(getLE16(desc+12));
+            decoded.numConfigs=desc[17];
+
+            // The kernel's descriptor of the default endpoint, linux-4.14.157/drivers/usb/core/hub.c.
+            // From SuperSpeed on, bMaxPacketSize0 is an exponent.
+            decoded.endpoint00.address=0;
+            decoded.endpoint00.attributes=0;
+            decoded.endpoint00.maxPacketSize = speed>=5000 ? 1u<<std::min(decoded.maxPacketSize, 15u) : decoded.maxPacketSize;
+            decoded.endpoint00.direction=Endpoint::Direction::Both;
+            decoded.endpoint00.type=Endpoint::Type::Control;
+            decoded.endpoint00.intervalBetweenTransfers=0;
+            decoded.endpoint00.intervalUnit=Endpoint::IntervalUnit::Milliseconds;
+            haveDeviceDescriptor=true;
+            break;
+        }
+        case DT_CONFIG:
+            if(len<9)
+            {
+                tooShort("config");
+                break;
+            }
+            config=&decoded.configs.emplace_back();
+            iface=nullptr;
+            config->numInterfaces=desc[4];
+            config->configNum=desc[5];
+            config->attributes=desc[7];
+            // bMaxPower is in units of 2 mA, or of 8 mA for SuperSpeed, see usb_get_max_power() in the kernel
+            config->maxPowerMilliAmp=desc[8] * (speed>=5000 ? 8 : 2);
+            break;
+        case DT_INTERFACE:
+            if(!config) break;
+            if(len<9)
+            {
+                tooShort("interface");
+                break;
+            }
+            iface=&config->interfaces.emplace_back();
+            iface->ifaceNum=desc[2];
+            iface->altSettingNum=desc[3];
+            iface->numEPs=desc[4];
+            iface->ifaceClass=desc[5];
+            iface->ifaceSubClass=desc[6];
+            iface->protocol=desc[7];
+            break;
+        case DT_ENDPOINT:
+            if(!iface) break;
+            if(len<7)
+            {
+                tooShort("endpoint");
+                break;
+            }
+            decodeEndpoint(desc, speed, iface->endpoints.emplace_back());
+            break;
+        }
+    }
+    if(!haveDeviceDescriptor)
+        bad("no device descriptor");
+
+    for(auto& config : decoded.configs)
+    {
+        std::stable_sort(config.interfaces.begin(), config.interfaces.end(), [](const auto& if1, const auto& if2)
+                         { return if1.ifaceNum < if2.ifaceNum; });
+    }
+}
+
+std::string_view viewOf(std::vector<uint8_t> const& data)
+{
+    return {reinterpret_cast<const char*>(data.data()), data.size()};
+}
+
+// Views into the bytes owned by the cached values
+struct DecodeKey
+{
+    std::string_view data;
+    double speed;
+    bool operator==(DecodeKey const& other) const { return data==other.data && speed==other.speed; }
+};
+struct DecodeKeyHash
+{
+    std::size_t operator()(DecodeKey const& key) const
+    {
+        return std::hash<std::string_view>{}(key.data) ^ std::hash<double>{}(key.speed);
+    }
+};
+
+std::mutex decodedMutex;
+std::unordered_map<DecodeKey, std::shared_ptr<const DecodedDescriptors>, DecodeKeyHash> decodedCache;
+std::mutex hidMutex;
+std::unordered_map<std::string_view, std::shared_ptr<const std::vector<uint8_t>>> hidCache;
+std::atomic<unsigned long> decodeHits{0}, decodeMisses{0}, hidHits{0}, hidMisses{0};
+
+}
+
+std::shared_ptr<const DecodedDescriptors> decodeDescriptors(std::vector<uint8_t>&& data, const double speed)
+{
+    {
+        std::lock_guard lock(decodedMutex);
+        const auto it=decodedCache.find({viewOf(data), speed});
+        if(it!=decodedCache.end())
+        {
+            ++decodeHits;
+            return it->second;
+        }
+    }
+    ++decodeMisses;
+    auto decoded=std::make_shared<DecodedDescriptors>();
+    decoded->data=std::move(data);
+    decode(*decoded, speed);
+
+    // Another thread may have decoded the same meanwhile, then its result is used
+    std::lock_guard lock(decodedMutex);
+    return decodedCache.try_emplace({viewOf(decoded->data), speed}, std::move(decoded)).first->second;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> internHIDReportDescriptor(std::vector<uint8_t>&& data)
+{
+    std::lock_guard lock(hidMutex);
+    const auto it=hidCache.find(viewOf(data));
+    if(it!=hidCache.end())
+    {
+        ++hidHits;
+        return it->second;
+    }
+    ++hidMisses;
+    auto interned=std::make_shared<const std::vector<uint8_t>>(std::move(data));
+    const auto key=viewOf(*interned);
+    return hidCache.emplace(key, std::move(interned)).first->second;
+}
+
+void releaseUnusedDescriptors()
+{
+    // An entry only the cache refers to can only be handed out again under the lock
+    {
+        std::lock_guard lock(decodedMutex);
+        for(auto it=decodedCache.begin(); it!=decodedCache.end();)
+        {
+            if(it->second.use_count()==1)
+                it=decodedCache.erase(it);
+            else
+                ++it;
+        }
+    }
+    std::lock_guard lock(hidMutex);
+    for(auto it=hidCache.begin(); it!=hidCache.end();)
+    {
+        if(it->second.use_count()==1)
+            it=hidCache.erase(it);
+        else
+            ++it;
+    }
+}
+
+DescriptorCacheStats descriptorCacheStats()
+{
+    return {decodeHits, decodeMisses, hidHits, hidMisses};
+}
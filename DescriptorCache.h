@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "Device.h"
+
+// Decoding results shared by identical devices. A rig with dozens of units of
+// one model has dozens of byte-identical descriptor sets and HID report
+// descriptors, which are decoded and kept once. The results are kept while
+// some device still refers to them.
+
+// Decodes the descriptors, or returns what was decoded earlier from the same
+// bytes at the same speed, which affects the decoding. Thread-safe.
+std::shared_ptr<const DecodedDescriptors> decodeDescriptors(std::vector<uint8_t>&& data, double speed);
+// Returns the earlier copy of the same bytes if there's one. Thread-safe.
+std::shared_ptr<const std::vector<uint8_t>> internHIDReportDescriptor(std::vector<uint8_t>&& data);
+// Forgets the results that no device refers to any more. Thread-safe.
+void releaseUnusedDescriptors();
+
+struct DescriptorCacheStats
+{
+    unsigned long decodeHits;
+    unsigned long decodeMisses;
+    unsigned long hidHits;
+    unsigned long hidMisses;
+};
+DescriptorCacheStats descriptorCacheStats();
@@ -1,32 +1,25 @@
 #include "Device.h"
 #include <map>
-#include <regex>
+#include <atomic>
+#include <algorithm>
 #include <string>
 #include <cassert>
-#include <clocale>
-#include <fstream>
-#include <iostream>
-#include <stdexcept>
 #include <string_view>
 #include <QObject>
 #include <QFileInfo>
 #include "util.hpp"
 #include "common.hpp"
-#include "usbids.h"
+#include "NameCache.h"
+#include "SysfsDir.h"
+#include "DeviceNodeIndex.h"
+#include "SysfsName.hpp"
+#include "DeviceSchema.hpp"
+#include "DescriptorCache.h"
 #include <libudev.h>
 
-#include <sys/sysmacros.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#undef major
-#undef minor
-
 namespace fs=std::filesystem;
 
-namespace
-{
-
-QString devClassName(const uint8_t classId)
+QString usbClassName(const unsigned classId)
 {
     switch(classId)
     {
@@ -56,286 +49,272 @@ QString devClassName(const uint8_t classId)
     }
 }
 
-QString getDevString(fs::path const& filePath)
+void Device::readInterfaceBinding(SysfsDir const& intDir, InterfaceBinding& binding)
 {
-    // This one may not exist
-    if(!fs::exists(filePath))
-        return QString();
-    return getString(filePath);
-}
+    binding.sysfsPath=QString::fromStdString(intDir.path());
 
-bool matches(std::string const& str, std::string const& pattern)
-{
-    return std::regex_match(str, std::regex(pattern));
-}
+    // If no such link, then there's no associated driver
+    binding.driver=InternedString(intDir.linkTargetName("driver"));
 
-std::vector<QString> findDeviceNodes(const unsigned major, const unsigned minor)
-{
-    std::vector<QString> nodes;
-    for(const auto& entry : fs::recursive_directory_iterator("/dev", fs::directory_options::skip_permission_denied))
+    // The directories may vanish along with the device, then we get what we've managed to read
+    std::error_code ec;
+    for(fs::directory_iterator it(intDir.path(), ec), end; !ec && it!=end; it.increment(ec))
     {
-        const auto& path=entry.path();
-        if(is_symlink(path)) continue;
-        if(!is_block_file(path) && !is_character_file(path)) continue;
+        const auto subPath=it->path();
+        const auto filename=subPath.filename().string();
 
-        struct stat st;
-        if(stat(path.string().c_str(), &st)<0)
+        // 0003 means BUS_USB
+        const auto subName=classifySysfsName(filename);
+        if(subName.kind==SysfsName::HID_DEVICE && subName.bus==0x0003 &&
+           subName.vendorId==vendorId && subName.productId==productId)
         {
-            perror(("stat("+path.string()+")").c_str());
-            continue;
+            if(const auto hidDir=SysfsDir::tryOpen(intDir, filename))
+                binding.hidReportDescriptors.emplace_back(internHIDReportDescriptor(hidDir->getData("report_descriptor")));
         }
-        if(gnu_dev_major(st.st_rdev)!=major || gnu_dev_minor(st.st_rdev)!=minor) continue;
 
-        nodes.emplace_back(QString::fromStdString(canonical(path).string()));
+        if(!it->is_directory(ec)) continue;
+        for(fs::recursive_directory_iterator subIt(subPath, fs::directory_options::skip_permission_denied, ec), subEnd;
+            !ec && subIt!=subEnd; subIt.increment(ec))
+        {
+            const auto& path=subIt->path();
+            if(path.filename().string()!="dev") continue;
+            if(!subIt->is_regular_file(ec)) continue;
+            auto devDir=SysfsDir::tryOpen(path.parent_path());
+            if(!devDir) continue;
+            devDir->reportTo(diagnostics);
+            const auto majorMinorStr=devDir->getString("dev").split(':');
+            if(majorMinorStr.size()!=2)
+            {
+                ++diagnosticCounters.parseFailures;
+                diagnostics.push_back(QString("Unexpected contents of \"%1\"").arg(path.c_str()));
+                continue;
+            }
+            bool majorOK=false, minorOK=false;
+            const int major=majorMinorStr[0].toUInt(&majorOK);
+            const int minor=majorMinorStr[1].toUInt(&minorOK);
+            if(!majorOK || !minorOK)
+            {
+                ++diagnosticCounters.parseFailures;
+                diagnostics.push_back(QString("Failed to parse device number from \"%1\"").arg(path.c_str()));
+                continue;
+            }
+            auto nodes=DeviceNodeIndex::instance().find(major,minor);
+            binding.deviceNodes.insert(binding.deviceNodes.end(), std::make_move_iterator(nodes.begin()),
+                                                                  std::make_move_iterator(nodes.end()));
+        }
     }
-    if(nodes.empty())
-        std::cerr << "Warning: couldn't find device node with major=" << major << ", minor=" << minor << "\n";
-    return nodes;
+    std::sort(binding.deviceNodes.begin(), binding.deviceNodes.end());
 }
 
-const char* hwdb_get(udev_hwdb* hwdb, const char* modalias, const char* key)
+void Device::readInterfaceBindings(SysfsDir const& devDir, SysfsName const& devName, std::string const& devDirName)
 {
-    udev_list_entry* entry;
-
-    udev_list_entry_foreach(entry, udev_hwdb_get_properties_list_entry(hwdb, modalias, 0))
+    const auto config=std::find_if(configs().begin(), configs().end(), [this](auto const& c){ return isActive(c); });
+    if(config==configs().end()) return;
+
+    // Only the current alternate setting of each interface of the active
+    // configuration has a directory. Its name is generated in
+    // linux-4.14.157/drivers/usb/core/message.c with format %d-%s:%d.%d,
+    // where %s is the device path, which is "0" for root hubs.
+    const auto intDirPrefix = devName.kind==SysfsName::ROOT_HUB ? std::to_string(busNum)+"-0" : devDirName;
+    std::vector<unsigned> ifaceNums;
+    std::vector<SysfsDir> intDirs;
+    for(const auto& iface : config->interfaces)
     {
-        if(!strcmp(udev_list_entry_get_name(entry), key))
-            return udev_list_entry_get_value(entry);
+        if(!ifaceNums.empty() && ifaceNums.back()==iface.ifaceNum) continue;
+        auto intDir=SysfsDir::tryOpen(devDir, intDirPrefix+":"+std::to_string(config->configNum)+"."+
+                                              std::to_string(iface.ifaceNum));
+        if(!intDir) continue;
+        ifaceNums.push_back(iface.ifaceNum);
+        intDirs.emplace_back(std::move(*intDir));
     }
 
-    return nullptr;
-}
-}
-
-void Device::parseEndpoint(fs::path const& epPath, Endpoint& ep)
-{
-    // Radices are defined in linux-4.14.157/core/endpoint.c
-    ep.address=getUInt(epPath/"bEndpointAddress", 16);
-    ep.attributes=getUInt(epPath/"bmAttributes", 16);
-    ep.direction=getString(epPath/"direction");
-    ep.type=getString(epPath/"type");
-    ep.maxPacketSize=getUInt(epPath/"wMaxPacketSize", 16);
+    SysfsBatch batch;
+    for(auto& intDir : intDirs)
+        batch.add(intDir, {"bAlternateSetting"});
+    batch.fetch();
 
+    interfaceBindings.resize(intDirs.size());
+    for(unsigned n=0; n<intDirs.size(); ++n)
     {
-        const auto intervalStr=getString(epPath/"interval").toStdString();
-        std::size_t pos;
-        ep.intervalBetweenTransfers=std::stoul(intervalStr, &pos);
-        ep.intervalUnit=QString::fromStdString(intervalStr.substr(pos));
+        interfaceBindings[n].ifaceNum=ifaceNums[n];
+        interfaceBindings[n].altSettingNum=intDirs[n].getUInt("bAlternateSetting", 10);
+        readInterfaceBinding(intDirs[n], interfaceBindings[n]);
     }
 }
 
-void Device::parseInterface(std::filesystem::path const& intPath, Interface& iface)
+void Device::setDescriptors(std::vector<uint8_t>&& data, const unsigned activeConfigNum)
 {
-    iface.activeAltSetting=false; //FIXME: where is this info located in /sys/bus/usb/devices?
-
-    iface.sysfsPath=QString::fromStdString(fs::canonical(intPath).string());
-
-    // Radices are defined in linux-4.14.157/core/sysfs.c
-    iface.ifaceNum=getUInt(intPath/"bInterfaceNumber", 16);
-    iface.altSettingNum=getUInt(intPath/"bAlternateSetting", 10);
-    iface.numEPs=getUInt(intPath/"bNumEndpoints", 16);
-    iface.ifaceClass=getUInt(intPath/"bInterfaceClass", 16);
-    iface.ifaceClassStr=devClassName(iface.ifaceClass);
-    iface.ifaceSubClass=getUInt(intPath/"bInterfaceSubClass", 16);
-    iface.protocol=getUInt(intPath/"bInterfaceProtocol", 16);
-
-    // If no such link, then there's no associated driver
-    const auto driverLink=intPath/"driver";
-    if(fs::exists(driverLink) && fs::is_symlink(driverLink))
-        iface.driver=QString::fromStdString(fs::read_symlink(driverLink).filename().string());
-
-	// 0003 means BUS_USB; the directory name itself is generated in linux-4.14.157/drivers/hid/hid-core.c
-	// with format %04X:%04X:%04X.%04X
-    const auto hidDirNamePrefix=QString("0003:%2:%3.").arg(vendorId, 4, 16, QChar('0'))
-                                                      .arg(productId, 4, 16, QChar('0'))
-                                                      .toUpper();
-    for(const auto& entry : fs::directory_iterator(intPath))
-    {
-        const auto epPath=entry.path();
-        const auto filename=epPath.filename().string();
-        if(startsWith(filename, "ep_") && matches(filename, "ep_..$"))
-        {
-            auto& ep=iface.endpoints.emplace_back();
-            parseEndpoint(epPath, ep);
-        }
-
-        if(startsWith(filename, hidDirNamePrefix.toStdString().c_str()))
-            iface.hidReportDescriptors.emplace_back(getFileData(entry.path()/"report_descriptor"));
-
-        if(is_directory(epPath))
-        {
-            for(const auto& entry : fs::recursive_directory_iterator(epPath, fs::directory_options::skip_permission_denied))
-            {
-                const auto& path=entry.path();
-                if(path.filename().string()!="dev") continue;
-                if(!is_regular_file(path)) continue;
-                const auto majorMinorStr=getString(path).split(':');
-                if(majorMinorStr.size()!=2)
-                {
-                    std::cerr << "Warning: unexpected contents of " << path << "\n";
-                    continue;
-                }
-                bool ok=false;
-                const int major=majorMinorStr[0].toUInt(&ok);
-                if(!ok)
-                {
-                    std::cerr << "Warning: failed to parse major device number " << path << "\n";
-                    continue;
-                }
-                const int minor=majorMinorStr[1].toUInt(&ok);
-                if(!ok)
-                {
-                    std::cerr << "Warning: failed to parse minor device number " << path << "\n";
-                    continue;
-                }
-                auto nodes=findDeviceNodes(major,minor);
-                iface.deviceNodes.insert(iface.deviceNodes.end(), std::make_move_iterator(nodes.begin()),
-                                                                  std::make_move_iterator(nodes.end()));
-            }
-            std::sort(iface.deviceNodes.begin(), iface.deviceNodes.end());
-        }
-    }
+    descriptors=decodeDescriptors(std::move(data), speed);
+    this->activeConfigNum=activeConfigNum;
+    const auto& decoded=*descriptors;
+    usbVersion=decoded.usbVersion;
+    devClass=decoded.devClass;
+    devSubClass=decoded.devSubClass;
+    devProtocol=decoded.devProtocol;
+    maxPacketSize=decoded.maxPacketSize;
+    vendorId=decoded.vendorId;
+    productId=decoded.productId;
+    revision=decoded.revision;
+    numConfigs=decoded.numConfigs;
+    endpoint00=decoded.endpoint00;
+    diagnosticCounters.parseFailures+=decoded.diagnostics.size();
+    diagnostics.insert(diagnostics.end(), decoded.diagnostics.begin(), decoded.diagnostics.end());
 }
 
-void Device::parseConfigs(fs::path const& devpath)
+DeviceInfo::InterfaceBinding const* DeviceInfo::binding(Config const& config, Interface const& iface) const
 {
-    auto& config=configs.emplace_back();
-    config.active=true; // FIXME: where can inactive configs be found? Answer: all config descriptors in binary form are in devpath/"descriptors" file.
-    config.numInterfaces=getUInt(devpath/"bNumInterfaces", 10);
-    config.configNum=getUInt(devpath/"bConfigurationValue", 10);
-    config.attributes=getUInt(devpath/"bmAttributes", 16);
-
-    const auto maxPower=getString(devpath/"bMaxPower");
-    if(!maxPower.endsWith("mA"))
-        throw std::invalid_argument("bMaxPower doesn't end in mA in file \""+devpath.string()+"\"");
-    config.maxPowerMilliAmp=getDouble(maxPower.chopped(2).toStdString());
-
-    parseEndpoint(devpath/"ep_00", endpoint00);
-
-    const auto busNumStr=std::to_string(busNum);
-    for(const auto& entry : fs::directory_iterator(devpath))
+    if(!isActive(config)) return nullptr;
+    for(const auto& binding : interfaceBindings)
     {
-        const auto intPath=entry.path();
-        const auto filename=intPath.filename().string();
-        if(!startsWith(filename, busNumStr) || !matches(filename, busNumStr+"-.*:.\\..*"))
-            continue;
-        auto& iface=config.interfaces.emplace_back();
-        parseInterface(intPath, iface);
+        if(binding.ifaceNum==iface.ifaceNum)
+            return &binding;
     }
-    std::sort(config.interfaces.begin(), config.interfaces.end(), [](const auto& if1, const auto& if2)
-              { return if1.ifaceNum < if2.ifaceNum; });
+    return nullptr;
 }
 
-void Device::readBinaryDescriptors(std::filesystem::path const& devpath)
+Device::Device(SysfsDir& devDir, SysfsName const& devName)
 {
-    std::ifstream file(devpath/"descriptors");
-    if(!file)
-        throw std::invalid_argument("Failed to open descriptors file under \""+devpath.string()+"\"");
-    file.seekg(0, std::ios_base::end);
-    const auto size=file.tellg();
-    file.seekg(0);
-    std::vector<uint8_t> data(size);
-    file.read(reinterpret_cast<char*>(data.data()), size);
-    if(!file)
+    devDir.reportTo(diagnostics);
     {
-        if(file.gcount()==0)
-            throw std::invalid_argument("Failed to read descriptors file under \""+devpath.string()+"\"");
-        data.resize(file.gcount());
+        static constexpr auto attributeNames=sysfsAttributeNames<deviceFields>();
+        SysfsBatch batch;
+        batch.add(devDir, attributeNames.data(), attributeNames.size());
+        batch.add(devDir, {"bConfigurationValue", "descriptors"});
+        batch.fetch();
     }
-    for(unsigned off=0; off<data.size();)
+    sysfsPath=QString::fromStdString(devDir.path());
+
+    busNum=devName.bus;
+    port=devName.port();
+    readSysfsFields(devDir, static_cast<DeviceInfo&>(*this), deviceFields);
+
+    // Everything else static is in the descriptors: the device itself, and all
+    // the configurations with all alternate settings of their interfaces.
     {
-        const unsigned len=data[off];
-        if(data.size() < off+len)
-            throw std::invalid_argument("Bad descriptor: length at offset "+std::to_string(off)+" overflows data size");
-        rawDescriptors.emplace_back(std::vector<uint8_t>(data.data()+off, data.data()+off+len));
-        off+=len;
+        // Empty if the device is unconfigured
+        const auto activeConfig=devDir.getOptionalString("bConfigurationValue");
+        setDescriptors(devDir.getData("descriptors"), parseUInt(activeConfig.toStdString(), 10).value_or(0));
     }
+    readInterfaceBindings(devDir, devName, fs::path(devDir.path()).filename().string());
+
+    setDevicePath();
+    setNames(NameCache::instance().lookup(vendorId, productId));
 }
 
-Device::Device(fs::path const& devpath, struct udev_hwdb* hwdb, USBIDS const& usbids)
+Device::Device(udev_device*const udevDevice, std::vector<InterfaceBinding> bindings)
 {
-	// Force '.' as the radix point, which is used by sysfs. We don't care to restore it
-	// after parsing, since we never display any numbers that should be localized.
-	std::setlocale(LC_NUMERIC,"C");
-
-    const auto& path=devpath.string();
-
-    sysfsPath=QString::fromStdString(fs::canonical(devpath).string());
+    const auto syspath=udev_device_get_syspath(udevDevice);
+    sysfsPath=syspath;
 
-    busNum=getUInt(devpath/"busnum", 10);
-    devNum=getUInt(devpath/"devnum", 10);
+    const auto missing=[this](const char* what)
+    {
+        ++diagnosticCounters.missingAttributes;
+        diagnostics.push_back(QString("Missing %1 of \"%2\" in udev database").arg(what, sysfsPath));
+    };
+    const auto required=[&missing](const char* value, const char* what)
+    {
+        if(!value) missing(what);
+        return value ? value : "";
+    };
+    const auto property=[&](const char* key) { return required(udev_device_get_property_value(udevDevice, key), key); };
+    const auto attribute=[&](const char* name) { return required(udev_device_get_sysattr_value(udevDevice, name), name); };
+    const auto optionalAttribute=[udevDevice](const char* name)
+    {
+        const auto value=udev_device_get_sysattr_value(udevDevice, name);
+        return value ? QString(value) : QString();
+    };
+    // A missing value has been reported already
+    const auto parsed=[this](auto const& value, const char* text, const char* what)
+    {
+        if(!value && *text)
+        {
+            ++diagnosticCounters.parseFailures;
+            diagnostics.push_back(QString("Failed to parse %1 of \"%2\" from \"%3\"").arg(what, sysfsPath, text));
+        }
+        return value.value_or(0);
+    };
+    const auto uintOf=[&parsed](const char* text, const char* what) { return parsed(parseUInt(text, 10), text, what); };
 
-	devicePath=QString("/dev/bus/usb/%1/%2").arg(busNum, 3, 10, QChar('0')).arg(devNum, 3, 10, QChar('0'));
-	if(!QFileInfo(devicePath).exists())
-		devicePath+=" (error: doesn't actually exist)";
+    busNum=uintOf(property("BUSNUM"), "BUSNUM");
+    port=classifySysfsName(udev_device_get_sysname(udevDevice)).port();
 
+    // The same attributes as in sysfs, via the udev cache
+    forEachField(deviceFields, [&](auto const& field)
     {
-        const auto sep=path.find_last_of(".-");
-        if(sep==path.npos)
-            port=0;
+        if(!field.sysfsName) return;
+        auto& value=static_cast<DeviceInfo&>(*this).*field.member;
+        using T=std::remove_reference_t<decltype(value)>;
+        if constexpr(std::is_same_v<T, QString>)
+            value = field.optional ? optionalAttribute(field.sysfsName) : QString(attribute(field.sysfsName));
+        else if constexpr(std::is_same_v<T, InternedString>)
+            value = field.optional ? InternedString(udev_device_get_sysattr_value(udevDevice, field.sysfsName))
+                                   : InternedString(attribute(field.sysfsName));
+        else if constexpr(std::is_floating_point_v<T>)
+        {
+            const auto text=attribute(field.sysfsName);
+            value=parsed(parseDouble(text), text, field.sysfsName);
+        }
         else
-            port=getUInt(path.substr(sep+1), 10);
-    }
-
-    speed=getDouble(devpath/"speed");
-    maxChildren=getUInt(devpath/"maxchild", 10);
-
-    usbVersion=getString(devpath/"version").trimmed();
-    devClass=getUInt(devpath/"bDeviceClass", 16);
-    devClassStr=devClassName(devClass);
-    devSubClass=getUInt(devpath/"bDeviceSubClass", 16);
-    devProtocol=getUInt(devpath/"bDeviceProtocol", 16);
-    maxPacketSize=getUInt(devpath/"bMaxPacketSize0", 10);
-    numConfigs=getUInt(devpath/"bNumConfigurations", 10);
-
-    vendorId=getUInt(devpath/"idVendor", 16);
-    productId=getUInt(devpath/"idProduct", 16);
+        {
+            const auto text=attribute(field.sysfsName);
+            value=parsed(parseUInt(text, field.radix), text, field.sysfsName);
+        }
+    });
 
-    const auto revBCD=getUInt(devpath/"bcdDevice", 16);
-    if(revBCD&0xf000)
     {
-        revision=QString("%1%2.%3%4").arg(QChar((revBCD>>12)+'0')).arg(QChar((revBCD>>8&0xf)+'0'))
-                                     .arg(QChar((revBCD>>4&0xf)+'0')).arg(QChar((revBCD&0xf)+'0'));
-    }
-    else
-    {
-        revision=QString("%1.%2%3").arg(QChar((revBCD>>8&0xf)+'0')).arg(QChar((revBCD>>4&0xf)+'0')).arg(QChar((revBCD&0xf)+'0'));
+        // The descriptors are binary, and sysattr values end at the first zero byte
+        std::vector<uint8_t> descriptors;
+        if(auto devDir=SysfsDir::tryOpen(fs::path(syspath)))
+        {
+            devDir->reportTo(diagnostics);
+            descriptors=devDir->getData("descriptors");
+        }
+        // Empty if the device is unconfigured
+        const auto activeConfig=optionalAttribute("bConfigurationValue");
+        setDescriptors(std::move(descriptors), parseUInt(activeConfig.toStdString(), 10).value_or(0));
     }
+    interfaceBindings=std::move(bindings);
+    setDevicePath();
+
+    // hwdb names come with the udev database, and usb.ids names are cached
+    auto names=NameCache::instance().lookup(vendorId, productId);
+    if(const auto vendor=udev_device_get_property_value(udevDevice, "ID_VENDOR_FROM_DATABASE"))
+        names.hwdbVendor=InternedString(vendor);
+    if(const auto model=udev_device_get_property_value(udevDevice, "ID_MODEL_FROM_DATABASE"))
+        names.hwdbProduct=InternedString(model);
+    setNames(names);
+}
 
-    manufacturer=getDevString(devpath/"manufacturer");
-    product=getDevString(devpath/"product");
-    serialNum=getDevString(devpath/"serial");
-
-    const auto vendorIdStr=QString("%1").arg(vendorId, 4, 16, QChar('0')).toUpper();
-    const auto productIdStr=QString("%1").arg(productId, 4, 16, QChar('0')).toUpper();
-    if(const auto s=hwdb_get(hwdb, QString("usb:v%1*").arg(vendorIdStr).toStdString().c_str(), "ID_VENDOR_FROM_DATABASE"))
-        hwdbVendorName=s;
-    if(const auto s=hwdb_get(hwdb, QString("usb:v%1p%2").arg(vendorIdStr, productIdStr).toStdString().c_str(), "ID_PRODUCT_FROM_DATABASE"))
-        hwdbProductName=s;
-
-    usbidsVendorName=usbids.vendor(vendorId);
-    usbidsProductName=usbids.product(vendorId, productId);
+void Device::updateNames()
+{
+    setNames(NameCache::instance().lookup(vendorId, productId));
+}
 
-    parseConfigs(devpath);
+void Device::setDevicePath()
+{
+	devicePath=QString("/dev/bus/usb/%1/%2").arg(busNum, 3, 10, QChar('0')).arg(devNum, 3, 10, QChar('0'));
+	if(!QFileInfo(devicePath).exists())
+		devicePath+=" (error: doesn't actually exist)";
+}
 
-    readBinaryDescriptors(devpath);
+void Device::setNames(DeviceNames const& names)
+{
+    static std::atomic<uint64_t> lastSnapshotId{0};
+    snapshotId=++lastSnapshotId;
 
-    const auto busNumStr=std::to_string(busNum);
-    for(const auto& entry : fs::directory_iterator(devpath))
-    {
-        const auto subDevPath=entry.path();
-        const auto filename=subDevPath.filename().string();
-        if(!startsWith(filename, busNumStr) || !matches(filename, busNumStr+"-[0-9]+(?:\\.[0-9]+)*$"))
-            continue;
-        children.emplace_back(std::make_unique<Device>(subDevPath, hwdb, usbids));
-    }
+    hwdbVendorName=names.hwdbVendor;
+    hwdbProductName=names.hwdbProduct;
+    usbidsVendorName=names.usbidsVendor;
+    usbidsProductName=names.usbidsProduct;
+    namesPending=names.pending;
 
     {
         // Make up the name
-        QString vendorName;
-        if(manufacturer=="Generic" || manufacturer.isEmpty())
+        const bool genericManufacturer = manufacturer.isNull() || manufacturer.view()=="Generic";
+        InternedString vendorName;
+        if(genericManufacturer)
         {
-            if(usbidsVendorName.isEmpty())
+            if(usbidsVendorName.isNull())
                 vendorName=hwdbVendorName;
             else
                 vendorName=usbidsVendorName;
@@ -344,17 +323,17 @@ Device::Device(fs::path const& devpath, struct udev_hwdb* hwdb, USBIDS const& us
             vendorName=manufacturer;
 
         QString productName;
-        if(!usbidsProductName.isEmpty())
-            productName=usbidsProductName;
-        else if(!hwdbProductName.isEmpty())
-            productName=hwdbProductName;
+        if(!usbidsProductName.isNull())
+            productName=usbidsProductName.toQString();
+        else if(!hwdbProductName.isNull())
+            productName=hwdbProductName.toQString();
         else
-            productName=devClassStr;
+            productName=usbClassName(devClass);
         // After all above, we still prefer product string, but only if manufacturer isn't "Generic" nor empty.
-        if(!manufacturer.isEmpty() && manufacturer!="Generic" && !product.isEmpty())
-            productName=product;
+        if(!genericManufacturer && !product.isNull())
+            productName=product.toQString();
 
-        name = QString("%1 %2").arg(vendorName, productName).trimmed();
+        name = QString("%1 %2").arg(vendorName.toQString(), productName).trimmed();
     }
 
     uniqueAddress=uint64_t(busNum)<<48 | uint64_t(devNum)<<32 | vendorId<<16 | productId;
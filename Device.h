@@ -5,29 +5,36 @@
 #include <string>
 #include <filesystem>
 #include <QString>
+#include "Diagnostics.hpp"
+#include "InternedString.h"
+#include "ByteView.hpp"
 
 using UniqueDeviceAddress=uint64_t;
 static constexpr UniqueDeviceAddress INVALID_UNIQUE_DEVICE_ADDRESS=-1;
 
-class USBIDS;
-struct Device
+class SysfsDir;
+struct SysfsName;
+struct DeviceNames;
+struct DecodedDescriptors;
+// Everything known about a device itself, without its place in the tree
+struct DeviceInfo
 {
     UniqueDeviceAddress uniqueAddress; // the value that's preserved across tree refresh, but changes on replugging
 
     QString sysfsPath;
     QString devicePath;
 
-	unsigned vendorId;
-	unsigned productId;
+	unsigned vendorId=0;
+	unsigned productId=0;
     QString revision;
 
-    QString hwdbVendorName;
-    QString hwdbProductName;
-    QString usbidsVendorName;
-    QString usbidsProductName;
+    InternedString hwdbVendorName;
+    InternedString hwdbProductName;
+    InternedString usbidsVendorName;
+    InternedString usbidsProductName;
 
-    QString manufacturer;
-    QString product;
+    InternedString manufacturer;
+    InternedString product;
     QString serialNum;
 
 	unsigned busNum;
@@ -37,62 +44,123 @@ struct Device
 	unsigned maxChildren;
 
     QString usbVersion;
-    unsigned devClass;
-    QString devClassStr;
-    unsigned devSubClass;
-    unsigned devProtocol;
-	unsigned maxPacketSize;
-	unsigned numConfigs;
+    unsigned devClass=0;
+    unsigned devSubClass=0;
+    unsigned devProtocol=0;
+	unsigned maxPacketSize=0;
+	unsigned numConfigs=0;
 
     struct Endpoint
     {
+        enum class Direction : uint8_t { In, Out, Both };
+        enum class Type : uint8_t { Control, Isochronous, Bulk, Interrupt };
+        enum class IntervalUnit : uint8_t { Microseconds, Milliseconds };
+
         unsigned address;
         unsigned attributes;
-        QString direction;
-        QString type;
+        Direction direction;
+        Type type;
         unsigned maxPacketSize;
         unsigned intervalBetweenTransfers;
-        QString intervalUnit;
+        IntervalUnit intervalUnit;
     };
     struct Interface
     {
-        QString sysfsPath;
-        std::vector<QString> deviceNodes;
-        bool activeAltSetting;
         unsigned ifaceNum;
         unsigned altSettingNum;
         unsigned numEPs;
         unsigned ifaceClass;
-        QString ifaceClassStr;
         unsigned ifaceSubClass;
         unsigned protocol;
-        QString driver;
-        std::vector<std::vector<uint8_t>> hidReportDescriptors;
         std::vector<Endpoint> endpoints;
     };
     struct Config
     {
-        bool active;
         unsigned numInterfaces;
         unsigned configNum;
         unsigned attributes;
         unsigned maxPowerMilliAmp;
         std::vector<Interface> interfaces;
     };
+    // What an interface of the active configuration is bound to
+    struct InterfaceBinding
+    {
+        unsigned ifaceNum;
+        unsigned altSettingNum; // the active one
+        QString sysfsPath;
+        InternedString driver;
+        std::vector<QString> deviceNodes;
+        std::vector<std::shared_ptr<const std::vector<uint8_t>>> hidReportDescriptors;
+    };
 
-    Endpoint endpoint00;
-    std::vector<Config> configs;
-
-    std::vector<std::vector<uint8_t>> rawDescriptors;
+    Endpoint endpoint00{};
+    // Shared by all the devices with the same descriptors
+    std::shared_ptr<const DecodedDescriptors> descriptors;
+    unsigned activeConfigNum=0; // 0 if unconfigured
+    std::vector<InterfaceBinding> interfaceBindings;
 
     QString name;
-    std::vector<std::unique_ptr<Device>> children;
+    // The database names are placeholders until NameCache has loaded the databases
+    bool namesPending=false;
+    // A new one each time the device is read or its names are looked up again, so views can tell whether it has changed
+    uint64_t snapshotId=0;
+    Diagnostics diagnostics;
+
+    std::vector<Config> const& configs() const;
+    std::vector<ByteRange> const& rawDescriptors() const;
+    ByteView bytes(ByteRange range) const;
+    bool isActive(Config const& config) const { return config.configNum==activeConfigNum; }
+    // Null unless the interface is in the active configuration
+    InterfaceBinding const* binding(Config const& config, Interface const& iface) const;
+};
+
+// What's decoded from the descriptors of a device, except for the device-level
+// fields, which are copied to DeviceInfo. Units of the same model have the same
+// descriptors, so they share one of these, see DescriptorCache.h.
+struct DecodedDescriptors
+{
+    std::vector<uint8_t> data; // as read from sysfs
+    std::vector<ByteRange> rawDescriptors; // in data
+    std::vector<DeviceInfo::Config> configs;
+    Diagnostics diagnostics;
+
+    // The device descriptor
+    QString usbVersion;
+    unsigned devClass=0;
+    unsigned devSubClass=0;
+    unsigned devProtocol=0;
+    unsigned maxPacketSize=0;
+    unsigned vendorId=0;
+    unsigned productId=0;
+    QString revision;
+    unsigned numConfigs=0;
+    DeviceInfo::Endpoint endpoint00{};
+};
+
+inline std::vector<DeviceInfo::Config> const& DeviceInfo::configs() const { return descriptors->configs; }
+inline std::vector<ByteRange> const& DeviceInfo::rawDescriptors() const { return descriptors->rawDescriptors; }
+inline ByteView DeviceInfo::bytes(const ByteRange range) const { return {descriptors->data.data()+range.offset, range.size}; }
 
-    explicit Device(std::filesystem::path const& devpath, struct udev_hwdb* hwdb, USBIDS const& usbids);
+// A device as read from sysfs or udev. Its place in the tree is kept by DeviceGraph.
+struct Device : DeviceInfo
+{
+    // devDir must have been opened by a canonical path, devName is the classified name of its last component
+    Device(SysfsDir& devDir, SysfsName const& devName);
+    // Reads the device from the udev database, the caller finds the interface bindings among its descendants
+    Device(struct udev_device* udevDevice, std::vector<InterfaceBinding> bindings);
+    // Reuses the info read earlier
+    explicit Device(DeviceInfo const& info) : DeviceInfo(info) {}
     bool isHub() const;
+    // Looks up the database names again, e.g. if they were pending
+    void updateNames();
 private:
-    void parseConfigs(std::filesystem::path const& devpath);
-    void parseEndpoint(std::filesystem::path const& devpath, Endpoint& ep);
-    void parseInterface(std::filesystem::path const& intPath, Interface& iface);
-    void readBinaryDescriptors(std::filesystem::path const& devpath);
+    void setDescriptors(std::vector<uint8_t>&& data, unsigned activeConfigNum);
+    void readInterfaceBindings(SysfsDir const& devDir, SysfsName const& devName, std::string const& devDirName);
+    void readInterfaceBinding(SysfsDir const& intDir, InterfaceBinding& binding);
+    // Checks the node, so it's done once when the device is read rather than with each name update
+    void setDevicePath();
+    void setNames(DeviceNames const& names);
 };
+
+// Name of a device or interface class code, as shown to the user
+QString usbClassName(unsigned classId);
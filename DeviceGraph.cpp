@@ -0,0 +1,56 @@
+#include "DeviceGraph.h"
+
+void DeviceGraph::reserve(const Index size)
+{
+    devices_.reserve(size);
+    links_.reserve(size);
+}
+
+DeviceGraph::Index DeviceGraph::find(QString const& sysfsPath) const
+{
+    for(Index n=0; n<devices_.size(); ++n)
+    {
+        if(devices_[n].sysfsPath==sysfsPath)
+            return n;
+    }
+    return NONE;
+}
+
+DeviceGraph::Index DeviceGraph::add(Device&& dev, const Index parent)
+{
+    const Index index=devices_.size();
+    devices_.emplace_back(std::move(dev));
+    links_.push_back({parent, NONE, NONE, NONE});
+    auto& parentLinks=linksOf(parent);
+    if(parentLinks.lastChild==NONE)
+        parentLinks.firstChild=index;
+    else
+        links_[parentLinks.lastChild].nextSibling=index;
+    parentLinks.lastChild=index;
+    return index;
+}
+
+void DeviceGraph::add(DeviceGraph&& subtree, const Index parent)
+{
+    if(subtree.empty()) return;
+
+    const Index offset=devices_.size();
+    const auto rebased=[offset](const Index index){ return index==NONE ? NONE : index+offset; };
+    for(auto& dev : subtree.devices_)
+        devices_.emplace_back(std::move(dev));
+    for(const auto& links : subtree.links_)
+    {
+        links_.push_back({links.parent==NONE ? parent : links.parent+offset,
+                          rebased(links.firstChild), rebased(links.lastChild), rebased(links.nextSibling)});
+    }
+
+    // Chain the roots of the subtree after the existing children
+    auto& parentLinks=linksOf(parent);
+    const auto firstRoot=rebased(subtree.roots_.firstChild);
+    if(parentLinks.lastChild==NONE)
+        parentLinks.firstChild=firstRoot;
+    else
+        links_[parentLinks.lastChild].nextSibling=firstRoot;
+    parentLinks.lastChild=rebased(subtree.roots_.lastChild);
+    subtree=DeviceGraph();
+}
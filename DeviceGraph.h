@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <vector>
+#include <QString>
+#include "Device.h"
+
+// The device tree in two contiguous arrays: the devices, and the links between
+// them as indices. Subtrees read in parallel are separate graphs, which are
+// appended to the parent's graph. A finished graph isn't modified: updates
+// make a new one, so a graph can be shared read-only between threads.
+class DeviceGraph
+{
+public:
+    using Index=uint32_t;
+    // The parent of the root hubs
+    static constexpr Index NONE=UINT32_MAX;
+
+private:
+    struct Links
+    {
+        Index parent=NONE;
+        Index firstChild=NONE;
+        Index lastChild=NONE;
+        Index nextSibling=NONE;
+    };
+    std::vector<Device> devices_;
+    std::vector<Links> links_;
+    Links roots_;
+
+    Links& linksOf(Index index) { return index==NONE ? roots_ : links_[index]; }
+    Links const& linksOf(Index index) const { return index==NONE ? roots_ : links_[index]; }
+
+public:
+    class ChildIterator
+    {
+        DeviceGraph const* graph_;
+        Index index_;
+    public:
+        using iterator_category=std::forward_iterator_tag;
+        using value_type=Index;
+        using difference_type=std::ptrdiff_t;
+        using pointer=Index const*;
+        using reference=Index;
+
+        ChildIterator(DeviceGraph const* graph, Index index) : graph_(graph), index_(index) {}
+        Index operator*() const { return index_; }
+        ChildIterator& operator++() { index_=graph_->links_[index_].nextSibling; return *this; }
+        ChildIterator operator++(int) { auto old=*this; ++*this; return old; }
+        bool operator==(ChildIterator const& other) const { return index_==other.index_; }
+        bool operator!=(ChildIterator const& other) const { return index_!=other.index_; }
+    };
+    struct ChildRange
+    {
+        ChildIterator first;
+        ChildIterator begin() const { return first; }
+        ChildIterator end() const { return {nullptr, NONE}; }
+        bool empty() const { return *first==NONE; }
+    };
+
+    bool empty() const { return devices_.empty(); }
+    Index size() const { return devices_.size(); }
+    void reserve(Index size);
+
+    Device const& operator[](Index index) const { return devices_[index]; }
+    Device& operator[](Index index) { return devices_[index]; }
+    Index parent(Index index) const { return links_[index].parent; }
+    // Children of NONE are the root hubs
+    ChildRange children(Index parent) const { return {{this, linksOf(parent).firstChild}}; }
+    // Returns NONE if there's no such device
+    Index find(QString const& sysfsPath) const;
+
+    // Appends the device as the last child of parent, and returns its index
+    Index add(Device&& dev, Index parent);
+    // Appends the roots of subtree as the last children of parent
+    void add(DeviceGraph&& subtree, Index parent);
+    template<typename Less>
+    void sortChildren(Index parent, Less less);
+};
+
+template<typename Less>
+void DeviceGraph::sortChildren(const Index parent, Less less)
+{
+    std::vector<Index> children;
+    for(const auto child : this->children(parent))
+        children.push_back(child);
+    std::stable_sort(children.begin(), children.end(),
+                     [this, &less](Index a, Index b){ return less(devices_[a], devices_[b]); });
+    auto& links=linksOf(parent);
+    links.firstChild=links.lastChild=NONE;
+    for(const auto child : children)
+    {
+        links_[child].nextSibling=NONE;
+        if(links.lastChild==NONE)
+            links.firstChild=child;
+        else
+            links_[links.lastChild].nextSibling=child;
+        links.lastChild=child;
+    }
+}
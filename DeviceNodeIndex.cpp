@@ -0,0 +1,202 @@
+#include "DeviceNodeIndex.h"
+#include <mutex>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/sysmacros.h>
+
+namespace fs=std::filesystem;
+
+namespace
+{
+constexpr uint32_t WATCH_MASK=IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ONLYDIR|IN_DONT_FOLLOW;
+}
+
+DeviceNodeIndex::DeviceNodeIndex()
+    : inotifyFd_(inotify_init1(IN_NONBLOCK|IN_CLOEXEC))
+{
+    if(inotifyFd_<0)
+        perror("Warning: inotify_init1 failed, /dev will be rescanned on each refresh");
+}
+
+DeviceNodeIndex::~DeviceNodeIndex()
+{
+    if(inotifyFd_>=0)
+        close(inotifyFd_);
+}
+
+DeviceNodeIndex& DeviceNodeIndex::instance()
+{
+    static DeviceNodeIndex index;
+    return index;
+}
+
+void DeviceNodeIndex::addNode(std::string const& path)
+{
+    struct stat st;
+    if(lstat(path.c_str(), &st)<0)
+    {
+        // It may have already been removed, and then we'll get the event for that
+        if(errno!=ENOENT)
+            perror(("stat("+path+")").c_str());
+        return;
+    }
+    if(!S_ISCHR(st.st_mode) && !S_ISBLK(st.st_mode)) return;
+    removeNode(path);
+    nodes_.emplace(path, st.st_rdev);
+    nodesByNumber_.emplace(st.st_rdev, path);
+}
+
+void DeviceNodeIndex::removeNode(std::string const& path)
+{
+    const auto it=nodes_.find(path);
+    if(it==nodes_.end()) return;
+    const auto [begin, end]=nodesByNumber_.equal_range(it->second);
+    for(auto numIt=begin; numIt!=end; ++numIt)
+    {
+        if(numIt->second==path)
+        {
+            nodesByNumber_.erase(numIt);
+            break;
+        }
+    }
+    nodes_.erase(it);
+}
+
+void DeviceNodeIndex::removeDir(std::string const& dirPath)
+{
+    const auto prefix=dirPath+"/";
+    const auto inDir=[&prefix](std::string const& path) { return path.compare(0, prefix.size(), prefix)==0; };
+    for(auto it=nodes_.begin(); it!=nodes_.end();)
+    {
+        const auto path=it->first;
+        ++it;
+        if(inDir(path))
+            removeNode(path);
+    }
+    // A moved directory keeps its watches, which would report its nodes under the old paths
+    for(auto it=watchedDirs_.begin(); it!=watchedDirs_.end();)
+    {
+        if(it->second==dirPath || inDir(it->second))
+        {
+            inotify_rm_watch(inotifyFd_, it->first);
+            it=watchedDirs_.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void DeviceNodeIndex::scan(std::string const& dirPath)
+{
+    const auto watch=[this](std::string const& path)
+    {
+        if(inotifyFd_<0) return;
+        const int wd=inotify_add_watch(inotifyFd_, path.c_str(), WATCH_MASK);
+        if(wd>=0)
+            watchedDirs_[wd]=path;
+    };
+
+    // The watch is added before listing the directory, so that nodes created meanwhile aren't missed
+    watch(dirPath);
+    std::error_code ec;
+    for(auto it=fs::recursive_directory_iterator(dirPath, fs::directory_options::skip_permission_denied, ec);
+        it!=fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        if(ec) break;
+        const auto type=it->symlink_status(ec).type();
+        if(type==fs::file_type::directory)
+            watch(it->path().string());
+        else if(type==fs::file_type::character || type==fs::file_type::block)
+            addNode(it->path().string());
+    }
+}
+
+void DeviceNodeIndex::rebuild()
+{
+    for(const auto& [wd, path] : watchedDirs_)
+        inotify_rm_watch(inotifyFd_, wd);
+    watchedDirs_.clear();
+    nodes_.clear();
+    nodesByNumber_.clear();
+    scan("/dev");
+    built_=true;
+}
+
+void DeviceNodeIndex::update()
+{
+    std::unique_lock lock(mutex_);
+    if(!built_ || inotifyFd_<0)
+    {
+        rebuild();
+        return;
+    }
+
+    bool overflow=false;
+    alignas(inotify_event) char buf[16384];
+    for(;;)
+    {
+        const auto size=read(inotifyFd_, buf, sizeof buf);
+        if(size<=0) break;
+        for(auto ptr=buf; ptr<buf+size;)
+        {
+            const auto& event=*reinterpret_cast<const inotify_event*>(ptr);
+            ptr+=sizeof(inotify_event)+event.len;
+
+            if(event.mask & IN_Q_OVERFLOW)
+                overflow=true;
+            if(overflow) continue;
+            const auto dirIt=watchedDirs_.find(event.wd);
+            if(dirIt==watchedDirs_.end()) continue;
+            if(event.mask & IN_IGNORED)
+            {
+                // The directory is gone, and so is everything under it
+                const auto dirPath=dirIt->second;
+                watchedDirs_.erase(dirIt);
+                removeDir(dirPath);
+                continue;
+            }
+            if(!event.len) continue;
+
+            const auto path=dirIt->second+"/"+event.name;
+            if(event.mask & (IN_CREATE|IN_MOVED_TO))
+            {
+                if(event.mask & IN_ISDIR)
+                {
+                    // Whatever was indexed under this path before is stale
+                    removeDir(path);
+                    scan(path);
+                }
+                else
+                    addNode(path);
+            }
+            else if(event.mask & (IN_DELETE|IN_MOVED_FROM))
+            {
+                if(event.mask & IN_ISDIR)
+                    removeDir(path);
+                else
+                    removeNode(path);
+            }
+        }
+    }
+    // Some events were lost, so we can't trust the index anymore
+    if(overflow)
+        rebuild();
+}
+
+std::vector<QString> DeviceNodeIndex::find(const unsigned major, const unsigned minor) const
+{
+    std::shared_lock lock(mutex_);
+    std::vector<QString> nodes;
+    const auto [begin, end]=nodesByNumber_.equal_range(makedev(major, minor));
+    for(auto it=begin; it!=end; ++it)
+        nodes.emplace_back(QString::fromStdString(it->second));
+    if(nodes.empty())
+        std::cerr << "Warning: couldn't find device node with major=" << major << ", minor=" << minor << "\n";
+    return nodes;
+}
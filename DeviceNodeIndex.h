@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <shared_mutex>
+#include <unordered_map>
+#include <sys/types.h>
+#include <QString>
+
+// Maps device numbers to nodes in /dev. The index is built by a single scan
+// of /dev, and then kept up to date from inotify events on its directories,
+// so each refresh only pays for the nodes that were created or removed.
+class DeviceNodeIndex
+{
+    mutable std::shared_mutex mutex_;
+    int inotifyFd_=-1;
+    bool built_=false;
+    std::unordered_map<int, std::string> watchedDirs_;
+    std::unordered_map<std::string, dev_t> nodes_;
+    std::unordered_multimap<dev_t, std::string> nodesByNumber_;
+
+    DeviceNodeIndex();
+    void rebuild();
+    void scan(std::string const& dirPath);
+    void addNode(std::string const& path);
+    void removeNode(std::string const& path);
+    void removeDir(std::string const& dirPath);
+public:
+    ~DeviceNodeIndex();
+    static DeviceNodeIndex& instance();
+
+    // Applies the changes that happened in /dev since the previous call
+    void update();
+    std::vector<QString> find(unsigned major, unsigned minor) const;
+};
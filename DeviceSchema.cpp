@@ -0,0 +1,135 @@
+#include "DeviceSchema.hpp"
+#include <QObject>
+
+QString formatSpeed(DeviceInfo const& dev)
+{
+    QString speed;
+    const auto speedX10=dev.speed*10;
+    switch(int(speedX10))
+    {
+    case 15:     speed=QObject::tr(u8"1.5\u202fMb/s (low)");   break;
+    case 120:    speed=QObject::tr(u8"12\u202fMb/s (full)");   break;
+    case 4800:   speed=QObject::tr(u8"480\u202fMb/s (high)");  break;
+    case 50000:  speed=QObject::tr(u8"5\u202fGb/s (super)");   break;
+    case 100000: speed=QObject::tr(u8"10\u202fGb/s (super+)"); break;
+    }
+    if(speedX10!=int(speedX10) || speed.isNull())
+    {
+        if(dev.speed<1000)
+            speed=QObject::tr(u8"%1\u202fMb/s").arg(dev.speed);
+        else
+            speed=QObject::tr(u8"%1\u202fGb/s").arg(dev.speed/1000);
+    }
+    return speed;
+}
+
+QString formatDeviceClass(DeviceInfo const& dev)
+{
+    return QString("0x%1 (%2)").arg(dev.devClass, 2, 16, QLatin1Char('0')).arg(usbClassName(dev.devClass));
+}
+
+QString formatMaxPower(DeviceInfo::Config const& config)
+{
+    return QObject::tr(u8"%1\u202fmA").arg(config.maxPowerMilliAmp);
+}
+
+QString formatInterfaceClass(DeviceInfo::Interface const& iface)
+{
+    return QString("0x%1 (%2)").arg(iface.ifaceClass, 2, 16, QLatin1Char('0')).arg(usbClassName(iface.ifaceClass));
+}
+
+QString formatDirection(DeviceInfo::Endpoint const& ep)
+{
+    using Direction=DeviceInfo::Endpoint::Direction;
+    switch(ep.direction)
+    {
+    case Direction::In:   return QObject::tr("In");
+    case Direction::Out:  return QObject::tr("Out");
+    case Direction::Both: return QObject::tr("Both");
+    }
+    return {};
+}
+
+QString formatTransferType(DeviceInfo::Endpoint const& ep)
+{
+    using Type=DeviceInfo::Endpoint::Type;
+    switch(ep.type)
+    {
+    case Type::Control:     return QObject::tr("Control");
+    case Type::Isochronous: return QObject::tr("Isochronous");
+    case Type::Bulk:        return QObject::tr("Bulk");
+    case Type::Interrupt:   return QObject::tr("Interrupt");
+    }
+    return {};
+}
+
+QString formatInterval(DeviceInfo::Endpoint const& ep)
+{
+    const auto unit = ep.intervalUnit==DeviceInfo::Endpoint::IntervalUnit::Microseconds ? QObject::tr("us") : QObject::tr("ms");
+    return QString(u8"%1\u202f%2").arg(ep.intervalBetweenTransfers).arg(unit);
+}
+
+QString formatBytes(const ByteView data, const bool wrap)
+{
+    QString str;
+    for(unsigned i=0; i<data.size(); ++i)
+    {
+        str += QString("%1 ").arg(+data[i], 2, 16, QChar('0'));
+        if(wrap && (i+1)%16 == 0)
+            str += '\n';
+    }
+    return str.trimmed();
+}
+
+namespace
+{
+
+template<typename Owner, typename Fields>
+void dumpFields(QString& out, Owner const& owner, Fields const& fields, const int indent)
+{
+    forEachField(fields, [&](auto const& field)
+    {
+        if(isShown(field, owner))
+            out += QString(indent, ' ') + field.label + ": " + formatField(field, owner) + "\n";
+    });
+}
+
+}
+
+QString dumpDevice(DeviceGraph const& graph, const DeviceGraph::Index index, const int indent)
+{
+    const auto& dev=graph[index];
+    QString out;
+    dumpFields(out, static_cast<DeviceInfo const&>(dev), deviceFields, indent);
+    for(const auto& config : dev.configs())
+    {
+        out += QString(indent+2, ' ') + (dev.isActive(config) ? "Configuration (active):\n" : "Configuration:\n");
+        dumpFields(out, config, configFields, indent+4);
+        for(const auto& iface : config.interfaces)
+        {
+            out += QString(indent+4, ' ') + "Interface:\n";
+            dumpFields(out, iface, interfaceFields, indent+6);
+            if(const auto binding=dev.binding(config, iface))
+            {
+                dumpFields(out, *binding, interfaceBindingFields, indent+6);
+                for(const auto& node : binding->deviceNodes)
+                    out += QString(indent+6, ' ') + "Device node: " + node + "\n";
+                for(const auto& desc : binding->hidReportDescriptors)
+                    out += QString(indent+6, ' ') + "HID report descriptor: " + formatBytes(*desc, false) + "\n";
+            }
+            for(const auto& ep : iface.endpoints)
+            {
+                out += QString(indent+6, ' ') + "Endpoint:\n";
+                dumpFields(out, ep, endpointFields, indent+8);
+            }
+        }
+    }
+    for(const auto range : dev.rawDescriptors())
+        out += QString(indent+2, ' ') + "Raw descriptor: " + formatBytes(dev.bytes(range), false) + "\n";
+    for(const auto child : graph.children(index))
+    {
+        out += QString(indent+2, ' ') + "Child device:\n";
+        out += dumpDevice(graph, child, indent+4);
+    }
+    return out;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+#include <QString>
+#include <QObject>
+#include "Device.h"
+#include "DeviceGraph.h"
+#include "SysfsDir.h"
+
+// The fields of Device and its parts, with their sources and presentation.
+// Reading, showing, dumping and comparing fields is generated from these
+// lists, so a new field usually needs just an entry here.
+
+enum class FieldFormat
+{
+    Text,
+    Decimal,
+    Hex2,
+    Hex4,
+};
+
+template<typename Owner, typename T>
+struct Field
+{
+    T Owner::* member;
+    const char* label;
+    FieldFormat format=FieldFormat::Text;
+    // The attribute in the sysfs directory of the owner, null if the field is derived from elsewhere
+    const char* sysfsName=nullptr;
+    int radix=10;
+    // A missing attribute isn't a problem, and a null value isn't shown
+    bool optional=false;
+    // Replaces the format, e.g. to add the meaning of a code
+    QString (*formatter)(Owner const&)=nullptr;
+};
+
+QString formatSpeed(DeviceInfo const& dev);
+QString formatDeviceClass(DeviceInfo const& dev);
+QString formatMaxPower(DeviceInfo::Config const& config);
+QString formatInterfaceClass(DeviceInfo::Interface const& iface);
+QString formatDirection(DeviceInfo::Endpoint const& ep);
+QString formatTransferType(DeviceInfo::Endpoint const& ep);
+QString formatInterval(DeviceInfo::Endpoint const& ep);
+
+inline constexpr auto deviceFields=std::make_tuple(
+    Field<DeviceInfo, QString >{&DeviceInfo::sysfsPath,         QT_TRANSLATE_NOOP("PropertiesWidget", "SYSFS path")},
+    Field<DeviceInfo, QString >{&DeviceInfo::devicePath,        QT_TRANSLATE_NOOP("PropertiesWidget", "Device path")},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::vendorId,          QT_TRANSLATE_NOOP("PropertiesWidget", "Vendor Id"), FieldFormat::Hex4},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::productId,         QT_TRANSLATE_NOOP("PropertiesWidget", "Product Id"), FieldFormat::Hex4},
+    Field<DeviceInfo, QString >{&DeviceInfo::revision,          QT_TRANSLATE_NOOP("PropertiesWidget", "Revision")},
+    Field<DeviceInfo, InternedString>{&DeviceInfo::manufacturer,      QT_TRANSLATE_NOOP("PropertiesWidget", "Manufacturer"), FieldFormat::Text, "manufacturer", 10, true},
+    Field<DeviceInfo, InternedString>{&DeviceInfo::product,           QT_TRANSLATE_NOOP("PropertiesWidget", "Product"), FieldFormat::Text, "product", 10, true},
+    Field<DeviceInfo, InternedString>{&DeviceInfo::hwdbVendorName,    QT_TRANSLATE_NOOP("PropertiesWidget", "Vendor name from HW DB"), FieldFormat::Text, nullptr, 10, true},
+    Field<DeviceInfo, InternedString>{&DeviceInfo::hwdbProductName,   QT_TRANSLATE_NOOP("PropertiesWidget", "Product name from HW DB"), FieldFormat::Text, nullptr, 10, true},
+    Field<DeviceInfo, InternedString>{&DeviceInfo::usbidsVendorName,  QT_TRANSLATE_NOOP("PropertiesWidget", "Vendor name from usb.ids"), FieldFormat::Text, nullptr, 10, true},
+    Field<DeviceInfo, InternedString>{&DeviceInfo::usbidsProductName, QT_TRANSLATE_NOOP("PropertiesWidget", "Product name from usb.ids"), FieldFormat::Text, nullptr, 10, true},
+    Field<DeviceInfo, QString >{&DeviceInfo::serialNum,         QT_TRANSLATE_NOOP("PropertiesWidget", "Serial number"), FieldFormat::Text, "serial", 10, true},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::busNum,            QT_TRANSLATE_NOOP("PropertiesWidget", "Bus"), FieldFormat::Decimal},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::devNum,            QT_TRANSLATE_NOOP("PropertiesWidget", "Address"), FieldFormat::Decimal, "devnum"},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::port,              QT_TRANSLATE_NOOP("PropertiesWidget", "Port"), FieldFormat::Decimal},
+    Field<DeviceInfo, QString >{&DeviceInfo::usbVersion,        QT_TRANSLATE_NOOP("PropertiesWidget", "USB version")},
+    Field<DeviceInfo, double  >{&DeviceInfo::speed,             QT_TRANSLATE_NOOP("PropertiesWidget", "Speed"), FieldFormat::Decimal, "speed", 10, false, formatSpeed},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::maxChildren,       QT_TRANSLATE_NOOP("PropertiesWidget", "Number of ports"), FieldFormat::Decimal, "maxchild"},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::devClass,          QT_TRANSLATE_NOOP("PropertiesWidget", "Device class"), FieldFormat::Hex2, nullptr, 10, false, formatDeviceClass},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::devSubClass,       QT_TRANSLATE_NOOP("PropertiesWidget", "Device subclass"), FieldFormat::Hex2},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::devProtocol,       QT_TRANSLATE_NOOP("PropertiesWidget", "Device protocol"), FieldFormat::Hex2},
+    Field<DeviceInfo, unsigned>{&DeviceInfo::maxPacketSize,     QT_TRANSLATE_NOOP("PropertiesWidget", "Max default endpoint packet size"), FieldFormat::Decimal}
+);
+
+inline constexpr auto configFields=std::make_tuple(
+    Field<DeviceInfo::Config, unsigned>{&DeviceInfo::Config::configNum,        QT_TRANSLATE_NOOP("PropertiesWidget", "Configuration number"), FieldFormat::Decimal},
+    Field<DeviceInfo::Config, unsigned>{&DeviceInfo::Config::attributes,       QT_TRANSLATE_NOOP("PropertiesWidget", "Attributes"), FieldFormat::Hex2},
+    Field<DeviceInfo::Config, unsigned>{&DeviceInfo::Config::maxPowerMilliAmp, QT_TRANSLATE_NOOP("PropertiesWidget", "Max power needed"), FieldFormat::Decimal, nullptr, 10, false, formatMaxPower}
+);
+
+inline constexpr auto interfaceFields=std::make_tuple(
+    Field<DeviceInfo::Interface, unsigned>{&DeviceInfo::Interface::ifaceNum,         QT_TRANSLATE_NOOP("PropertiesWidget", "Interface number"), FieldFormat::Decimal},
+    Field<DeviceInfo::Interface, unsigned>{&DeviceInfo::Interface::altSettingNum,    QT_TRANSLATE_NOOP("PropertiesWidget", "Alternate setting number"), FieldFormat::Decimal},
+    Field<DeviceInfo::Interface, unsigned>{&DeviceInfo::Interface::ifaceClass,       QT_TRANSLATE_NOOP("PropertiesWidget", "Class"), FieldFormat::Hex2, nullptr, 10, false, formatInterfaceClass},
+    Field<DeviceInfo::Interface, unsigned>{&DeviceInfo::Interface::ifaceSubClass,    QT_TRANSLATE_NOOP("PropertiesWidget", "Subclass"), FieldFormat::Hex2},
+    Field<DeviceInfo::Interface, unsigned>{&DeviceInfo::Interface::protocol,         QT_TRANSLATE_NOOP("PropertiesWidget", "Protocol"), FieldFormat::Hex2}
+);
+
+inline constexpr auto interfaceBindingFields=std::make_tuple(
+    Field<DeviceInfo::InterfaceBinding, unsigned      >{&DeviceInfo::InterfaceBinding::altSettingNum, QT_TRANSLATE_NOOP("PropertiesWidget", "Active alternate setting number"),
+                                                        FieldFormat::Decimal},
+    Field<DeviceInfo::InterfaceBinding, QString       >{&DeviceInfo::InterfaceBinding::sysfsPath,     QT_TRANSLATE_NOOP("PropertiesWidget", "SYSFS path")},
+    Field<DeviceInfo::InterfaceBinding, InternedString>{&DeviceInfo::InterfaceBinding::driver,        QT_TRANSLATE_NOOP("PropertiesWidget", "Driver"), FieldFormat::Text, nullptr, 10, true}
+);
+
+inline constexpr auto endpointFields=std::make_tuple(
+    Field<DeviceInfo::Endpoint, unsigned>{&DeviceInfo::Endpoint::address,       QT_TRANSLATE_NOOP("PropertiesWidget", "Address"), FieldFormat::Hex2},
+    Field<DeviceInfo::Endpoint, DeviceInfo::Endpoint::Direction>{&DeviceInfo::Endpoint::direction, QT_TRANSLATE_NOOP("PropertiesWidget", "Direction"), FieldFormat::Text,
+                                                                 nullptr, 10, false, formatDirection},
+    Field<DeviceInfo::Endpoint, unsigned>{&DeviceInfo::Endpoint::attributes,    QT_TRANSLATE_NOOP("PropertiesWidget", "Attributes"), FieldFormat::Hex2},
+    Field<DeviceInfo::Endpoint, DeviceInfo::Endpoint::Type>{&DeviceInfo::Endpoint::type, QT_TRANSLATE_NOOP("PropertiesWidget", "Transfer type"), FieldFormat::Text,
+                                                            nullptr, 10, false, formatTransferType},
+    Field<DeviceInfo::Endpoint, unsigned>{&DeviceInfo::Endpoint::maxPacketSize, QT_TRANSLATE_NOOP("PropertiesWidget", "Max packet size"), FieldFormat::Decimal},
+    Field<DeviceInfo::Endpoint, unsigned>{&DeviceInfo::Endpoint::intervalBetweenTransfers, QT_TRANSLATE_NOOP("PropertiesWidget", "Interval between transfers"),
+                                          FieldFormat::Decimal, nullptr, 10, false, formatInterval}
+);
+
+template<typename Fields, typename Function>
+void forEachField(Fields const& fields, Function&& function)
+{
+    std::apply([&function](auto const&... field){ (function(field), ...); }, fields);
+}
+
+// The sysfs attributes of the fields, to be fetched in one batch
+template<auto const& fields>
+constexpr auto sysfsAttributeNames()
+{
+    constexpr std::size_t count=std::apply([](auto const&... field)
+                                           { return (std::size_t(field.sysfsName!=nullptr) + ... + 0); }, fields);
+    std::array<const char*, count> names{};
+    std::size_t n=0;
+    std::apply([&names, &n](auto const&... field)
+               { ((field.sysfsName ? void(names[n++]=field.sysfsName) : void()), ...); }, fields);
+    return names;
+}
+
+template<typename Owner, typename Fields>
+void readSysfsFields(SysfsDir const& dir, Owner& owner, Fields const& fields)
+{
+    forEachField(fields, [&dir, &owner](auto const& field)
+    {
+        if(!field.sysfsName) return;
+        auto& value=owner.*field.member;
+        using T=std::remove_reference_t<decltype(value)>;
+        if constexpr(std::is_same_v<T, QString>)
+            value = field.optional ? dir.getOptionalString(field.sysfsName) : dir.getString(field.sysfsName);
+        else if constexpr(std::is_same_v<T, InternedString>)
+            value = field.optional ? dir.getOptionalInterned(field.sysfsName) : dir.getInterned(field.sysfsName);
+        else if constexpr(std::is_floating_point_v<T>)
+            value=dir.getDouble(field.sysfsName);
+        else
+            value=dir.getUInt(field.sysfsName, field.radix);
+    });
+}
+
+template<typename Owner, typename T>
+bool isShown(Field<Owner, T> const& field, Owner const& owner)
+{
+    if constexpr(std::is_same_v<T, QString> || std::is_same_v<T, InternedString>)
+        return !field.optional || !(owner.*field.member).isNull();
+    else
+        return true;
+}
+
+template<typename Owner, typename T>
+QString formatField(Field<Owner, T> const& field, Owner const& owner)
+{
+    if(field.formatter)
+        return field.formatter(owner);
+    const auto& value=owner.*field.member;
+    if constexpr(std::is_same_v<T, QString>)
+        return value;
+    else if constexpr(std::is_same_v<T, InternedString>)
+        return value.toQString();
+    else if constexpr(std::is_enum_v<T>)
+        return QString::number(static_cast<int>(value));
+    else if constexpr(std::is_same_v<T, bool>)
+        return value ? QObject::tr("yes") : QObject::tr("no");
+    else if constexpr(std::is_floating_point_v<T>)
+        return QString::number(value);
+    else
+    {
+        switch(field.format)
+        {
+        case FieldFormat::Hex2: return QString("0x%1").arg(value, 2, 16, QLatin1Char('0'));
+        case FieldFormat::Hex4: return QString("0x%1").arg(value, 4, 16, QLatin1Char('0'));
+        default:                return QString::number(value);
+        }
+    }
+}
+
+// Labels of the fields that differ
+template<typename Owner, typename Fields>
+std::vector<const char*> changedFields(Owner const& a, Owner const& b, Fields const& fields)
+{
+    std::vector<const char*> labels;
+    forEachField(fields, [&](auto const& field)
+    {
+        if(!(a.*field.member == b.*field.member))
+            labels.push_back(field.label);
+    });
+    return labels;
+}
+
+// Hex bytes separated by spaces, and by newlines after every 16 if wrapped
+QString formatBytes(ByteView data, bool wrap);
+
+// A plain-text snapshot of the device with its configurations and descendants, one field per line
+QString dumpDevice(DeviceGraph const& graph, DeviceGraph::Index index, int indent=0);
@@ -1,26 +1,613 @@
+#include <map>
+#include <mutex>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
 #include <filesystem>
-#include <libudev.h>
+#include <string_view>
+#include <unordered_map>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include "DeviceTree.h"
-#include "usbids.h"
+#include "TaskGroup.h"
+#include "SysfsDir.h"
+#include "DeviceNodeIndex.h"
+#include "SysfsName.hpp"
+#include "UdevDeviceTree.h"
+#include "NameCache.h"
+#include "DeviceSchema.hpp"
+#include "DescriptorCache.h"
 #include "util.hpp"
 
-std::vector<std::unique_ptr<Device>> readDeviceTree()
+namespace fs=std::filesystem;
+
+namespace
+{
+
+EnumerationBackend enumerationBackend=EnumerationBackend::Sysfs;
+
+struct DevicePath
+{
+    fs::path path;
+    SysfsName name;
+};
+
+// Devices read by the previous enumerations, keyed by canonical sysfs path
+struct CachedDevice
+{
+    unsigned devNum;
+    QString activeConfig;
+    std::size_t descriptorsHash;
+    unsigned generation;
+    DeviceInfo info;
+};
+std::mutex deviceCacheMutex;
+std::unordered_map<std::string, CachedDevice> deviceCache;
+std::atomic<unsigned> cacheGeneration{0};
+std::atomic<unsigned> cacheHits{0};
+
+// Entries not used since the given generation are of unplugged devices
+void pruneDeviceCache(const unsigned generation)
+{
+    std::lock_guard lock(deviceCacheMutex);
+    for(auto it=deviceCache.begin(); it!=deviceCache.end();)
+    {
+        if(it->second.generation < generation)
+            it=deviceCache.erase(it);
+        else
+            ++it;
+    }
+    releaseUnusedDescriptors();
+}
+
+void forgetCachedDevices(std::string const& sysfsPath, const bool withDescendants)
+{
+    std::lock_guard lock(deviceCacheMutex);
+    deviceCache.erase(sysfsPath);
+    if(!withDescendants) return;
+    for(auto it=deviceCache.begin(); it!=deviceCache.end();)
+    {
+        if(startsWith(it->first, sysfsPath+"/"))
+            it=deviceCache.erase(it);
+        else
+            ++it;
+    }
+}
+
+// Returns nothing if the device has been unplugged
+std::optional<Device> makeDevice(DevicePath const& devpath)
+{
+    auto devDirOpened=SysfsDir::tryOpen(devpath.path);
+    if(!devDirOpened)
+    {
+        ++diagnosticCounters.vanishedDevices;
+        return std::nullopt;
+    }
+    auto& devDir=*devDirOpened;
+    {
+        SysfsBatch batch;
+        batch.add(devDir, {"devnum", "bConfigurationValue", "descriptors"});
+        batch.fetch();
+    }
+    // Replugging changes devnum, while reconfiguration, firmware updates and
+    // mode switches change the descriptors or the active configuration.
+    // Driver binding changes are caught by HotplugMonitor, which makes us forget the device.
+    const auto devNum=devDir.getUInt("devnum", 10);
+    const auto activeConfig=devDir.getOptionalString("bConfigurationValue");
+    const auto descriptors=devDir.getData("descriptors");
+    const auto descriptorsHash=std::hash<std::string_view>{}({reinterpret_cast<const char*>(descriptors.data()),
+                                                              descriptors.size()});
+    {
+        std::lock_guard lock(deviceCacheMutex);
+        const auto it=deviceCache.find(devDir.path());
+        if(it!=deviceCache.end())
+        {
+            auto& cached=it->second;
+            if(cached.devNum==devNum && cached.activeConfig==activeConfig && cached.descriptorsHash==descriptorsHash)
+            {
+                cached.generation=cacheGeneration;
+                ++cacheHits;
+                Device dev(cached.info);
+                if(dev.namesPending)
+                {
+                    dev.updateNames();
+                    cached.info=dev;
+                }
+                return dev;
+            }
+        }
+    }
+
+    Device dev(devDir, devpath.name);
+    if(!dev.diagnostics.empty())
+    {
+        // Problems are expected if it's been unplugged while we were reading it
+        std::error_code ec;
+        if(!fs::exists(devpath.path, ec))
+        {
+            ++diagnosticCounters.vanishedDevices;
+            return std::nullopt;
+        }
+        // Don't remember what may be a transient failure
+        return dev;
+    }
+    std::lock_guard lock(deviceCacheMutex);
+    deviceCache.insert_or_assign(devDir.path(), CachedDevice{devNum, activeConfig, descriptorsHash, cacheGeneration, dev});
+    return dev;
+}
+
+// Returns an empty graph if the device has been unplugged or the read has been cancelled
+DeviceGraph readDevice(DevicePath const& devpath, CancelFlag const* cancelled)
 {
-    static const auto udev=udev_new();
-    static const auto hwdb = udev ? udev_hwdb_new(udev) : nullptr;
-    static USBIDS usbids;
+    if(cancelled && *cancelled) return {};
+    auto dev=makeDevice(devpath);
+    if(!dev) return {};
 
-    std::vector<std::unique_ptr<Device>> devices;
-    namespace fs=std::filesystem;
-    for(const auto& entry : fs::directory_iterator(fs::u8path(u8"/sys/bus/usb/devices/")))
+    std::vector<DevicePath> childPaths;
+    std::error_code ec;
+    for(fs::directory_iterator it(devpath.path, ec), end; !ec && it!=end; it.increment(ec))
     {
-        if(!startsWith(entry.path().filename().string(), "usb"))
+        const auto name=classifySysfsName(it->path().filename().native());
+        if(name.kind!=SysfsName::DEVICE || name.bus!=dev->busNum)
             continue;
-        devices.emplace_back(std::make_unique<Device>(entry.path(), hwdb, usbids));
+        childPaths.push_back({it->path(), name});
+    }
+
+    // Each child subtree is read by its own task into its own graph. The slots
+    // are allocated beforehand to keep the children in directory order.
+    std::vector<DeviceGraph> children(childPaths.size());
+    TaskGroup tasks;
+    for(unsigned n=0; n<childPaths.size(); ++n)
+        tasks.run([&children, &childPaths, n, cancelled]{ children[n]=readDevice(childPaths[n], cancelled); });
+    tasks.wait();
+
+    DeviceGraph graph;
+    DeviceGraph::Index size=1;
+    for(const auto& child : children)
+        size+=child.size();
+    graph.reserve(size);
+    const auto index=graph.add(std::move(*dev), DeviceGraph::NONE);
+    for(auto& child : children)
+        graph.add(std::move(child), index);
+    return graph;
+}
+
+// A subtree re-read after a hotplug event
+struct SubtreeUpdate
+{
+    QString parentPath; // empty for root hubs
+    DeviceGraph subtree; // empty if it's been removed
+};
+
+// Copies the children of oldParent into newParent, with the updated subtrees in
+// place of the old ones, and appends the subtrees of newly plugged children
+void copyUpdated(DeviceGraph const& old, const DeviceGraph::Index oldParent, DeviceGraph& updated,
+                 const DeviceGraph::Index newParent, std::map<QString, SubtreeUpdate>& updates)
+{
+    for(const auto child : old.children(oldParent))
+    {
+        const auto it=updates.find(old[child].sysfsPath);
+        if(it==updates.end())
+        {
+            const auto copy=updated.add(Device(old[child]), newParent);
+            copyUpdated(old, child, updated, copy, updates);
+            continue;
+        }
+        auto& subtree=it->second.subtree;
+        // The root of a re-read subtree is its first device
+        if(!subtree.empty() && std::getenv("USBVIEW_STATS"))
+        {
+            std::cerr << "Updated " << old[child].sysfsPath.toStdString() << ", changed:";
+            for(const auto label : changedFields<DeviceInfo>(old[child], subtree[0], deviceFields))
+                std::cerr << " \"" << label << '"';
+            std::cerr << "\n";
+        }
+        updated.add(std::move(subtree), newParent);
+        updates.erase(it);
+    }
+
+    const auto parentPath = oldParent==DeviceGraph::NONE ? QString() : old[oldParent].sysfsPath;
+    for(auto it=updates.begin(); it!=updates.end();)
+    {
+        if(it->second.parentPath!=parentPath)
+        {
+            ++it;
+            continue;
+        }
+        updated.add(std::move(it->second.subtree), newParent);
+        it=updates.erase(it);
+    }
+}
+
+void clearDeviceCache()
+{
+    std::lock_guard lock(deviceCacheMutex);
+    deviceCache.clear();
+    releaseUnusedDescriptors();
+}
+
+void sortByBus(DeviceGraph& graph)
+{
+    graph.sortChildren(DeviceGraph::NONE, [](Device const& d1, Device const& d2){ return d1.busNum < d2.busNum; });
+}
+
+}
+
+DeviceGraph readDeviceTree(std::function<void(DeviceGraph const&)> const& onRootHub, CancelFlag const*const cancelled)
+{
+    DeviceNodeIndex::instance().update();
+    // Cached devices have the old names
+    if(NameCache::instance().revalidate())
+        clearDeviceCache();
+
+    const auto generation=++cacheGeneration;
+    const auto cacheHitsBefore=cacheHits.load();
+    const auto syscallsBefore=SysfsDir::syscallCount();
+    std::vector<DeviceGraph> rootHubs;
+    if(enumerationBackend==EnumerationBackend::Udev)
+    {
+        const auto rootHubPaths=listUdevRootHubs();
+        rootHubs.resize(rootHubPaths.size());
+        TaskGroup tasks;
+        for(unsigned n=0; n<rootHubPaths.size(); ++n)
+        {
+            tasks.run([&rootHubs, &rootHubPaths, &onRootHub, n, cancelled]
+            {
+                if(cancelled && *cancelled) return;
+                rootHubs[n]=readUdevSubtree(rootHubPaths[n]);
+                if(onRootHub && !rootHubs[n].empty() && !(cancelled && *cancelled))
+                    onRootHub(rootHubs[n]);
+            });
+        }
+        tasks.wait();
+    }
+    else
+    {
+        std::vector<DevicePath> rootHubPaths;
+        std::error_code ec;
+        for(fs::directory_iterator it(fs::u8path(u8"/sys/bus/usb/devices/"), ec), end; !ec && it!=end; it.increment(ec))
+        {
+            const auto& entry=*it;
+            const auto name=classifySysfsName(entry.path().filename().native());
+            if(name.kind!=SysfsName::ROOT_HUB)
+                continue;
+            // Children are listed under the canonical path, so they are canonical too
+            std::error_code canonicalError;
+            auto path=fs::canonical(entry.path(), canonicalError);
+            if(canonicalError)
+            {
+                ++diagnosticCounters.vanishedDevices;
+                continue;
+            }
+            rootHubPaths.push_back({std::move(path), name});
+        }
+
+        rootHubs.resize(rootHubPaths.size());
+        TaskGroup tasks;
+        for(unsigned n=0; n<rootHubPaths.size(); ++n)
+        {
+            tasks.run([&rootHubs, &rootHubPaths, &onRootHub, n, cancelled]
+            {
+                rootHubs[n]=readDevice(rootHubPaths[n], cancelled);
+                if(onRootHub && !rootHubs[n].empty() && !(cancelled && *cancelled))
+                    onRootHub(rootHubs[n]);
+            });
+        }
+        tasks.wait();
     }
 
-    std::sort(devices.begin(), devices.end(), [](auto const& d1, auto const& d2)
-              {return d1->busNum < d2->busNum;});
+    DeviceGraph devices;
+    DeviceGraph::Index size=0;
+    for(const auto& rootHub : rootHubs)
+        size+=rootHub.size();
+    devices.reserve(size);
+    for(auto& rootHub : rootHubs)
+        devices.add(std::move(rootHub), DeviceGraph::NONE);
+    sortByBus(devices);
+    NameCache::instance().save();
+    // Devices that haven't been visited aren't necessarily unplugged
+    if(cancelled && *cancelled)
+        return {};
+    pruneDeviceCache(generation);
+
+    if(std::getenv("USBVIEW_STATS"))
+    {
+        const auto syscalls=SysfsDir::syscallCount()-syscallsBefore;
+        const auto deviceCount=devices.size();
+        std::cerr << "Enumeration: " << deviceCount << " devices, " << syscalls << " sysfs attribute syscalls";
+        if(deviceCount)
+            std::cerr << " (" << double(syscalls)/deviceCount << " per device)";
+        std::cerr << ", " << cacheHits-cacheHitsBefore << " reused from cache\n";
+        const auto strings=InternedString::poolStats();
+        std::cerr << "Strings: " << strings.distinct << " interned, " << strings.textBytes << " bytes of text\n";
+        const auto decodes=descriptorCacheStats();
+        std::cerr << "Descriptors: " << decodes.decodeMisses << " decoded, " << decodes.decodeHits << " shared; HID report descriptors: "
+                  << decodes.hidMisses << " distinct, " << decodes.hidHits << " shared\n";
+        const auto names=NameCache::instance().stats();
+        std::cerr << "Names since startup: " << names.hits << " cached, " << names.misses << " looked up, "
+                  << names.pending << " deferred, " << names.invalidations << " database changes\n";
+        std::cerr << "Problems since startup: " << diagnosticCounters.missingAttributes << " missing attributes, "
+                  << diagnosticCounters.parseFailures << " parse failures, "
+                  << diagnosticCounters.vanishedDevices << " vanished devices\n";
+    }
 
     return devices;
 }
+
+DeviceGraph updateDeviceSubtrees(DeviceGraph const& tree, std::vector<std::string> sysfsPaths, CancelFlag const*const cancelled)
+{
+    // A re-read subtree covers all the changes below its root
+    std::sort(sysfsPaths.begin(), sysfsPaths.end());
+    sysfsPaths.erase(std::unique(sysfsPaths.begin(), sysfsPaths.end(), [](auto const& ancestor, auto const& path)
+                                 { return path==ancestor || startsWith(path, ancestor+"/"); }),
+                     sysfsPaths.end());
+
+    DeviceNodeIndex::instance().update();
+    // Cached devices have the old names
+    if(NameCache::instance().revalidate())
+        clearDeviceCache();
+    std::map<QString, SubtreeUpdate> updates;
+    for(const auto& sysfsPath : sysfsPaths)
+    {
+        // Changes in driver binding aren't visible to the cache validation
+        std::error_code ec;
+        forgetCachedDevices(sysfsPath, !fs::exists(sysfsPath, ec));
+
+        const fs::path path(sysfsPath);
+        const auto name=classifySysfsName(path.filename().native());
+        if(name.kind!=SysfsName::DEVICE && name.kind!=SysfsName::ROOT_HUB)
+            continue;
+
+        QString parentPath;
+        if(name.kind==SysfsName::DEVICE)
+        {
+            parentPath=QString::fromStdString(path.parent_path().string());
+            if(tree.find(parentPath)==DeviceGraph::NONE)
+            {
+                // We don't know where to put it, so start over
+                return readDeviceTree({}, cancelled);
+            }
+        }
+        if(cancelled && *cancelled)
+            return {};
+        auto subtree = enumerationBackend==EnumerationBackend::Udev ? readUdevSubtree(sysfsPath)
+                                                                    : readDevice({path, name}, cancelled);
+        updates.insert_or_assign(QString::fromStdString(sysfsPath), SubtreeUpdate{parentPath, std::move(subtree)});
+    }
+
+    // At most the old tree plus all the re-read subtrees, so the appends below don't reallocate
+    DeviceGraph::Index size=tree.size();
+    for(const auto& [path, update] : updates)
+        size+=update.subtree.size();
+    DeviceGraph updated;
+    updated.reserve(size);
+    copyUpdated(tree, DeviceGraph::NONE, updated, DeviceGraph::NONE, updates);
+    sortByBus(updated);
+    NameCache::instance().save();
+    return updated;
+}
+
+DeviceGraph resolvePendingNames(DeviceGraph tree)
+{
+    for(DeviceGraph::Index n=0; n<tree.size(); ++n)
+    {
+        if(tree[n].namesPending)
+            tree[n].updateNames();
+    }
+    NameCache::instance().save();
+    return tree;
+}
+
+void setEnumerationBackend(const EnumerationBackend backend)
+{
+    enumerationBackend=backend;
+}
+
+namespace
+{
+
+// Only glibc tells
+std::optional<std::size_t> heapInUse()
+{
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#else
+    return unsigned(mallinfo().uordblks);
+#endif
+#else
+    return std::nullopt;
+#endif
+}
+
+std::optional<std::size_t> heapGrowth(std::optional<std::size_t> const& before)
+{
+    const auto after=heapInUse();
+    if(!before || !after) return std::nullopt;
+    return *after-*before;
+}
+
+// Measures the heap taken by the strings of the tree in the pool, against what the
+// same values took before interning: a QString per field of each device, including
+// the class names and endpoint enums that are now formatted on display.
+void measureStringMemory(DeviceGraph const& tree)
+{
+    std::vector<InternedString> interned;
+    const auto addInterned=[&interned](const InternedString str) { if(!str.isNull()) interned.push_back(str); };
+    std::size_t classNames=0, endpoints=0;
+    for(DeviceGraph::Index n=0; n<tree.size(); ++n)
+    {
+        const auto& dev=tree[n];
+        for(const auto str : {dev.manufacturer, dev.product, dev.hwdbVendorName, dev.hwdbProductName,
+                              dev.usbidsVendorName, dev.usbidsProductName})
+            addInterned(str);
+        for(const auto& binding : dev.interfaceBindings)
+            addInterned(binding.driver);
+        ++classNames;
+        ++endpoints;
+        for(const auto& config : dev.configs())
+        {
+            for(const auto& iface : config.interfaces)
+            {
+                ++classNames;
+                endpoints+=iface.endpoints.size();
+            }
+        }
+    }
+
+    // A copy of the pool with only the strings of this tree, built the same way
+    std::vector<std::string_view> distinct;
+    for(const auto str : interned)
+        distinct.push_back(str.view());
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    std::optional<std::size_t> poolBytes;
+    {
+        const auto before=heapInUse();
+        std::unordered_map<std::string_view, std::unique_ptr<std::string>> pool;
+        for(const auto str : distinct)
+        {
+            auto owned=std::make_unique<std::string>(str);
+            const std::string_view key(*owned);
+            pool.emplace(key, std::move(owned));
+        }
+        poolBytes=heapGrowth(before);
+    }
+
+    // The sysfs texts of direction, transfer type and interval unit
+    const char*const directions[]={"in", "out", "both"};
+    const char*const types[]={"Control", "Isoc", "Bulk", "Interrupt"};
+    const char*const units[]={"us", "ms"};
+    std::vector<QString> separate;
+    separate.reserve(interned.size()+classNames+3*endpoints);
+    std::optional<std::size_t> separateBytes;
+    {
+        const auto before=heapInUse();
+        for(const auto str : interned)
+            separate.push_back(str.toQString());
+        const auto addEndpoint=[&](DeviceInfo::Endpoint const& ep)
+        {
+            separate.push_back(QString(directions[int(ep.direction)]));
+            separate.push_back(QString(types[int(ep.type)]));
+            separate.push_back(QString(units[int(ep.intervalUnit)]));
+        };
+        for(DeviceGraph::Index n=0; n<tree.size(); ++n)
+        {
+            const auto& dev=tree[n];
+            separate.push_back(usbClassName(dev.devClass));
+            addEndpoint(dev.endpoint00);
+            for(const auto& config : dev.configs())
+            {
+                for(const auto& iface : config.interfaces)
+                {
+                    separate.push_back(usbClassName(iface.ifaceClass));
+                    for(const auto& ep : iface.endpoints)
+                        addEndpoint(ep);
+                }
+            }
+        }
+        separateBytes=heapGrowth(before);
+    }
+
+    if(!poolBytes || !separateBytes)
+    {
+        std::cout << "Strings of " << tree.size() << " devices: " << distinct.size() << " distinct interned, "
+                  << separate.size() << " separate QStrings, heap use unavailable\n";
+        return;
+    }
+    std::cout << "Strings of " << tree.size() << " devices: " << distinct.size() << " distinct in " << *poolBytes
+              << " bytes of heap interned, " << separate.size() << " separate QStrings in " << *separateBytes << " bytes";
+    if(!tree.empty())
+        std::cout << " (" << (double(*separateBytes)-*poolBytes)/tree.size() << " bytes saved per device)";
+    std::cout << "\n";
+}
+
+// Whether the backends have read the same devices in the same order, with the same bindings
+bool sameDevices(DeviceGraph const& tree1, const DeviceGraph::Index parent1,
+                 DeviceGraph const& tree2, const DeviceGraph::Index parent2)
+{
+    auto it1=tree1.children(parent1).begin();
+    auto it2=tree2.children(parent2).begin();
+    const auto end1=tree1.children(parent1).end();
+    const auto end2=tree2.children(parent2).end();
+    for(; it1!=end1 && it2!=end2; ++it1, ++it2)
+    {
+        const auto& dev1=tree1[*it1];
+        const auto& dev2=tree2[*it2];
+        if(dev1.sysfsPath!=dev2.sysfsPath || dev1.descriptors!=dev2.descriptors ||
+           dev1.interfaceBindings.size()!=dev2.interfaceBindings.size())
+        {
+            std::cerr << "Backends differ at " << dev1.sysfsPath.toStdString() << "\n";
+            return false;
+        }
+        for(std::size_t n=0; n<dev1.interfaceBindings.size(); ++n)
+        {
+            const auto& binding1=dev1.interfaceBindings[n];
+            const auto& binding2=dev2.interfaceBindings[n];
+            if(binding1.sysfsPath!=binding2.sysfsPath || binding1.driver!=binding2.driver ||
+               binding1.deviceNodes!=binding2.deviceNodes || binding1.hidReportDescriptors!=binding2.hidReportDescriptors)
+            {
+                std::cerr << "Backends differ at " << binding1.sysfsPath.toStdString() << "\n";
+                return false;
+            }
+        }
+        if(!sameDevices(tree1, *it1, tree2, *it2))
+            return false;
+    }
+    if(it1!=end1 || it2!=end2)
+    {
+        std::cerr << "Backends differ in the number of children of "
+                  << (parent1==DeviceGraph::NONE ? "the computer" : tree1[parent1].sysfsPath.toStdString()) << "\n";
+        return false;
+    }
+    return true;
+}
+
+}
+
+void benchmarkEnumerationBackends(const unsigned rounds)
+{
+    const auto oldBackend=enumerationBackend;
+
+    // Timing them is only fair if they build the same tree
+    clearDeviceCache();
+    enumerationBackend=EnumerationBackend::Sysfs;
+    const auto sysfsTree=readDeviceTree();
+    clearDeviceCache();
+    enumerationBackend=EnumerationBackend::Udev;
+    const auto udevTree=readDeviceTree();
+    if(!sameDevices(sysfsTree, DeviceGraph::NONE, udevTree, DeviceGraph::NONE))
+        std::cerr << "Warning: the backends have read different trees, the timings aren't comparable\n";
+    measureStringMemory(sysfsTree);
+
+    const auto run=[rounds](const char* title, const EnumerationBackend backend, const bool withDeviceCache)
+    {
+        enumerationBackend=backend;
+        // The first read warms up the name cache, the page cache and the thread pool
+        clearDeviceCache();
+        readDeviceTree();
+
+        std::vector<double> times;
+        unsigned deviceCount=0;
+        for(unsigned n=0; n<rounds; ++n)
+        {
+            if(!withDeviceCache)
+                clearDeviceCache();
+            const auto start=std::chrono::steady_clock::now();
+            const auto tree=readDeviceTree();
+            const std::chrono::duration<double, std::milli> time=std::chrono::steady_clock::now()-start;
+            times.push_back(time.count());
+            deviceCount=tree.size();
+        }
+        std::sort(times.begin(), times.end());
+        std::cout << title << ": " << deviceCount << " devices, min " << times.front()
+                  << " ms, median " << times[times.size()/2] << " ms\n";
+    };
+    run("sysfs", EnumerationBackend::Sysfs, false);
+    run("sysfs with device cache", EnumerationBackend::Sysfs, true);
+    run("udev", EnumerationBackend::Udev, false);
+    enumerationBackend=oldBackend;
+}
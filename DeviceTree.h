@@ -1,5 +1,29 @@
+#pragma once
+
+#include <atomic>
 #include <memory>
+#include <string>
 #include <vector>
-#include "Device.h"
+#include <functional>
+#include "DeviceGraph.h"
+
+// Set from another thread to make a read in progress return an empty graph early
+using CancelFlag=std::atomic<bool>;
+
+// onRootHub, if given, is called from worker threads with each root hub subtree as soon as it's read
+DeviceGraph readDeviceTree(std::function<void(DeviceGraph const&)> const& onRootHub={}, CancelFlag const* cancelled=nullptr);
+// Re-reads the subtrees rooted at the given canonical sysfs paths of devices that
+// have been added, changed or removed, and returns the tree with them patched in
+DeviceGraph updateDeviceSubtrees(DeviceGraph const& tree, std::vector<std::string> sysfsPaths,
+                                 CancelFlag const* cancelled=nullptr);
+// Returns the tree with the pending names of its devices looked up, see NameCache::whenDatabasesLoaded
+DeviceGraph resolvePendingNames(DeviceGraph tree);
 
-std::vector<std::unique_ptr<Device>> readDeviceTree();
+enum class EnumerationBackend
+{
+    Sysfs, // walks sysfs directories and reads the attributes
+    Udev,  // queries the udev database
+};
+void setEnumerationBackend(EnumerationBackend backend);
+// Reads the whole tree the given number of times with each backend, and prints the timings
+void benchmarkEnumerationBackends(unsigned rounds);
@@ -0,0 +1,410 @@
+#include "DeviceTreeModel.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <QBrush>
+
+DeviceTreeModel::DeviceTreeModel(QObject* parent)
+    : QAbstractItemModel(parent)
+{
+    root_.fetched=true;
+    root_.children.push_back(makeNode({0, Kind::Computer, nullptr, DeviceGraph::NONE, 0}, &root_, 0));
+}
+
+DeviceTreeModel::Node* DeviceTreeModel::nodeOf(QModelIndex const& index) const
+{
+    if(!index.isValid())
+        return const_cast<Node*>(&root_);
+    return static_cast<Node*>(index.internalPointer());
+}
+
+QModelIndex DeviceTreeModel::indexOf(Node const& node) const
+{
+    if(&node==&root_)
+        return {};
+    return createIndex(node.row, 0, const_cast<Node*>(&node));
+}
+
+std::unique_ptr<DeviceTreeModel::Node> DeviceTreeModel::makeNode(ChildSpec const& spec, Node*const parent, const int row) const
+{
+    auto node=std::make_unique<Node>(Node{spec.key, spec.kind, spec.graph, spec.index, spec.port, parent, row, false, {}});
+    node->fetched=!hasChildSpecs(*node);
+    return node;
+}
+
+Device const* DeviceTreeModel::deviceOf(Node const& node) const
+{
+    // The index may be stale while the rows of a new tree are being reconciled
+    if(node.kind!=Kind::Device || !node.graph || node.index>=node.graph->size())
+        return nullptr;
+    return &(*node.graph)[node.index];
+}
+
+Device const* DeviceTreeModel::device(QModelIndex const& index) const
+{
+    return deviceOf(*nodeOf(index));
+}
+
+QString DeviceTreeModel::formatName(Device const& dev) const
+{
+    if(vendorProductIdsShown_)
+        return QString("%1:%2 %3").arg(dev.vendorId, 4, 16, QLatin1Char('0'))
+                                  .arg(dev.productId, 4, 16, QLatin1Char('0'))
+                                  .arg(dev.name);
+    else
+        return dev.name;
+}
+
+bool DeviceTreeModel::matchesFindText(Device const& dev) const
+{
+    if(findText_.isEmpty()) return false;
+    const auto contains=[this](QString const& str) { return str.contains(findText_, Qt::CaseInsensitive); };
+    const auto ids=QString("%1:%2").arg(dev.vendorId, 4, 16, QLatin1Char('0')).arg(dev.productId, 4, 16, QLatin1Char('0'));
+    return contains(dev.name) || contains(ids) ||
+           contains(dev.manufacturer.toQString()) || contains(dev.product.toQString()) ||
+           contains(dev.hwdbVendorName.toQString()) || contains(dev.hwdbProductName.toQString()) ||
+           contains(dev.usbidsVendorName.toQString()) || contains(dev.usbidsProductName.toQString());
+}
+
+std::vector<DeviceTreeModel::ChildSpec> DeviceTreeModel::childSpecs(Node const& node) const
+{
+    std::vector<ChildSpec> specs;
+    const auto deviceSpec=[](DeviceGraph const& graph, const DeviceGraph::Index index)
+    {
+        return ChildSpec{graph[index].uniqueAddress, Kind::Device, &graph, index, 0};
+    };
+    switch(node.kind)
+    {
+    case Kind::Computer:
+        for(const auto& graph : graphs_)
+        {
+            for(const auto rootHub : graph->children(DeviceGraph::NONE))
+                specs.push_back(deviceSpec(*graph, rootHub));
+        }
+        break;
+    case Kind::Port:
+        if(node.index!=DeviceGraph::NONE)
+            specs.push_back(deviceSpec(*node.graph, node.index));
+        break;
+    case Kind::Device:
+    {
+        const auto devPtr=deviceOf(node);
+        if(!devPtr) break;
+        const auto& graph=*node.graph;
+        const auto& dev=*devPtr;
+        if(portsShown_ && dev.maxChildren)
+        {
+            // dev is a hub, show all its ports between the hub and the children
+            std::vector<DeviceGraph::Index> byPort(dev.maxChildren+1, DeviceGraph::NONE);
+            for(const auto child : graph.children(node.index))
+            {
+                if(graph[child].port <= dev.maxChildren)
+                    byPort[graph[child].port]=child;
+            }
+            // Device addresses have a nonzero bus number in the high bits, so they can't clash with port numbers
+            for(unsigned port=1; port <= dev.maxChildren; ++port)
+                specs.push_back({port, Kind::Port, &graph, byPort[port], port});
+        }
+        else
+        {
+            for(const auto child : graph.children(node.index))
+                specs.push_back(deviceSpec(graph, child));
+        }
+        break;
+    }
+    }
+    return specs;
+}
+
+void DeviceTreeModel::reconcile(Node& node)
+{
+    if(!node.fetched) return;
+    const auto specs=childSpecs(node);
+    const auto parentIndex=indexOf(node);
+    auto& children=node.children;
+
+    std::unordered_map<uint64_t, std::size_t> wanted;
+    for(std::size_t n=0; n<specs.size(); ++n)
+        wanted.emplace(specs[n].key, n);
+    // Point the surviving rows into the new tree before the view gets any signal
+    for(auto& child : children)
+    {
+        const auto it=wanted.find(child->key);
+        child->graph = it==wanted.end() ? nullptr : specs[it->second].graph;
+        child->index = it==wanted.end() ? DeviceGraph::NONE : specs[it->second].index;
+    }
+
+    const auto renumberFrom=[&children](const std::size_t first)
+    {
+        for(auto row=first; row<children.size(); ++row)
+            children[row]->row=row;
+    };
+    // From the end, so that the rows yet to check keep their numbers
+    for(int row=int(children.size())-1; row>=0; --row)
+    {
+        if(wanted.count(children[row]->key)) continue;
+        beginRemoveRows(parentIndex, row, row);
+        children.erase(children.begin()+row);
+        renumberFrom(row);
+        endRemoveRows();
+    }
+
+    // The survivors only come out of order if e.g. bus numbers have been reassigned, then the level starts over
+    bool ordered=true;
+    for(std::size_t row=1; row<children.size() && ordered; ++row)
+        ordered = wanted[children[row-1]->key] < wanted[children[row]->key];
+    if(!ordered)
+    {
+        beginRemoveRows(parentIndex, 0, int(children.size())-1);
+        children.clear();
+        endRemoveRows();
+    }
+
+    std::unordered_set<uint64_t> existing;
+    for(const auto& child : children)
+        existing.insert(child->key);
+    for(std::size_t first=0; first<specs.size();)
+    {
+        if(existing.count(specs[first].key))
+        {
+            ++first;
+            continue;
+        }
+        auto last=first;
+        while(last+1<specs.size() && !existing.count(specs[last+1].key))
+            ++last;
+        beginInsertRows(parentIndex, first, last);
+        for(auto n=first; n<=last; ++n)
+            children.insert(children.begin()+n, makeNode(specs[n], &node, n));
+        renumberFrom(first);
+        endInsertRows();
+        first=last+1;
+    }
+
+    // Labels, fonts and highlighting may have changed for any of them
+    if(!children.empty())
+        emit dataChanged(index(0, 0, parentIndex), index(int(children.size())-1, 0, parentIndex));
+    for(auto& child : children)
+        reconcile(*child);
+}
+
+void DeviceTreeModel::reconcileAll()
+{
+    for(auto& child : root_.children)
+        reconcile(*child);
+}
+
+void DeviceTreeModel::notifyAllChanged(Node const& node)
+{
+    if(node.children.empty()) return;
+    const auto parentIndex=indexOf(node);
+    emit dataChanged(index(0, 0, parentIndex), index(int(node.children.size())-1, 0, parentIndex));
+    for(const auto& child : node.children)
+        notifyAllChanged(*child);
+}
+
+void DeviceTreeModel::setGraphs(std::shared_ptr<const DeviceGraph> tree, std::vector<std::shared_ptr<const DeviceGraph>> graphs)
+{
+    // The rows point into the old graphs until reconciled
+    const auto oldGraphs=std::move(graphs_);
+    tree_=std::move(tree);
+    graphs_=std::move(graphs);
+    reconcileAll();
+}
+
+void DeviceTreeModel::setTree(std::shared_ptr<const DeviceGraph> tree)
+{
+    std::vector<std::shared_ptr<const DeviceGraph>> graphs;
+    if(tree)
+        graphs.push_back(tree);
+    setGraphs(std::move(tree), std::move(graphs));
+}
+
+void DeviceTreeModel::setRootHubs(std::vector<std::shared_ptr<const DeviceGraph>> rootHubs)
+{
+    setGraphs(nullptr, std::move(rootHubs));
+}
+
+void DeviceTreeModel::setShowPorts(const bool enable)
+{
+    if(portsShown_==enable) return;
+    portsShown_=enable;
+    reconcileAll();
+}
+
+void DeviceTreeModel::setShowVendorProductIds(const bool enable)
+{
+    if(vendorProductIdsShown_==enable) return;
+    vendorProductIdsShown_=enable;
+    notifyAllChanged(root_);
+}
+
+void DeviceTreeModel::setFindText(QString const& text)
+{
+    findText_=text;
+    notifyAllChanged(root_);
+}
+
+DeviceTreeModel::Node* DeviceTreeModel::fetchChild(Node& node, const uint64_t key, const Kind kind)
+{
+    fetchMore(indexOf(node));
+    for(const auto& child : node.children)
+    {
+        if(child->key==key && child->kind==kind)
+            return child.get();
+    }
+    return nullptr;
+}
+
+QModelIndex DeviceTreeModel::fetchRow(DeviceGraph const& graph, const DeviceGraph::Index index)
+{
+    std::vector<DeviceGraph::Index> path;
+    for(auto n=index; n!=DeviceGraph::NONE; n=graph.parent(n))
+        path.push_back(n);
+    // From the computer row down
+    auto node=root_.children.front().get();
+    for(auto it=path.rbegin(); it!=path.rend() && node; ++it)
+    {
+        const auto& dev=graph[*it];
+        auto child=fetchChild(*node, dev.uniqueAddress, Kind::Device);
+        // With the ports shown, the device is below its port row
+        if(!child)
+        {
+            if(const auto port=fetchChild(*node, dev.port, Kind::Port))
+                child=fetchChild(*port, dev.uniqueAddress, Kind::Device);
+        }
+        node=child;
+    }
+    return node ? indexOf(*node) : QModelIndex{};
+}
+
+std::vector<QModelIndex> DeviceTreeModel::fetchMatches()
+{
+    std::vector<QModelIndex> matches;
+    if(findText_.isEmpty()) return matches;
+    // The graphs, as the rows below collapsed hubs may not have been fetched
+    for(const auto& graph : graphs_)
+    {
+        const std::function<void(DeviceGraph::Index)> find=[&](const DeviceGraph::Index parent)
+        {
+            for(const auto child : graph->children(parent))
+            {
+                if(matchesFindText((*graph)[child]))
+                {
+                    if(const auto index=fetchRow(*graph, child); index.isValid())
+                        matches.push_back(index);
+                }
+                find(child);
+            }
+        };
+        find(DeviceGraph::NONE);
+    }
+    return matches;
+}
+
+QModelIndex DeviceTreeModel::index(const int row, const int column, QModelIndex const& parent) const
+{
+    const auto node=nodeOf(parent);
+    if(column!=0 || row<0 || std::size_t(row)>=node->children.size())
+        return {};
+    return createIndex(row, 0, node->children[row].get());
+}
+
+QModelIndex DeviceTreeModel::parent(QModelIndex const& index) const
+{
+    if(!index.isValid()) return {};
+    return indexOf(*nodeOf(index)->parent);
+}
+
+int DeviceTreeModel::rowCount(QModelIndex const& parent) const
+{
+    if(parent.column()>0) return 0;
+    return nodeOf(parent)->children.size();
+}
+
+int DeviceTreeModel::columnCount(QModelIndex const&) const
+{
+    return 1;
+}
+
+bool DeviceTreeModel::hasChildSpecs(Node const& node) const
+{
+    switch(node.kind)
+    {
+    case Kind::Computer:
+        return std::any_of(graphs_.begin(), graphs_.end(),
+                           [](auto const& graph){ return !graph->children(DeviceGraph::NONE).empty(); });
+    case Kind::Port:
+        return node.index!=DeviceGraph::NONE;
+    case Kind::Device:
+        if(const auto dev=deviceOf(node))
+            return (portsShown_ && dev->maxChildren) || !node.graph->children(node.index).empty();
+        return false;
+    }
+    return false;
+}
+
+bool DeviceTreeModel::hasChildren(QModelIndex const& parent) const
+{
+    const auto node=nodeOf(parent);
+    if(node->fetched)
+        return !node->children.empty();
+    return hasChildSpecs(*node);
+}
+
+bool DeviceTreeModel::canFetchMore(QModelIndex const& parent) const
+{
+    return !nodeOf(parent)->fetched && hasChildren(parent);
+}
+
+void DeviceTreeModel::fetchMore(QModelIndex const& parent)
+{
+    const auto node=nodeOf(parent);
+    if(node->fetched) return;
+    node->fetched=true;
+    const auto specs=childSpecs(*node);
+    if(specs.empty()) return;
+    beginInsertRows(parent, 0, int(specs.size())-1);
+    for(std::size_t row=0; row<specs.size(); ++row)
+        node->children.push_back(makeNode(specs[row], node, row));
+    endInsertRows();
+}
+
+QVariant DeviceTreeModel::data(QModelIndex const& index, const int role) const
+{
+    if(!index.isValid()) return {};
+    const auto node=nodeOf(index);
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        switch(node->kind)
+        {
+        case Kind::Computer:
+            return QString("Computer");
+        case Kind::Port:
+            return QString("[Port %1]").arg(node->port);
+        case Kind::Device:
+            if(const auto dev=device(index))
+                return formatName(*dev);
+            return {};
+        }
+        break;
+    case Qt::FontRole:
+        if(const auto dev=device(index); dev && !dev->isHub())
+            return boldFont_;
+        break;
+    case Qt::BackgroundRole:
+        if(const auto dev=device(index); dev && matchesFindText(*dev))
+            return QBrush(Qt::yellow);
+        break;
+    }
+    return {};
+}
+
+QVariant DeviceTreeModel::headerData(const int section, const Qt::Orientation orientation, const int role) const
+{
+    if(section==0 && orientation==Qt::Horizontal && role==Qt::DisplayRole)
+        return QString("USB devices");
+    return {};
+}
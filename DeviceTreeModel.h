@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <QFont>
+#include <QAbstractItemModel>
+#include "DeviceGraph.h"
+
+// The device graph as a tree model. Rows are created when the view fetches
+// them, and labels are only formatted for the rows being displayed. Rows are
+// keyed by device address or port number, so a new graph only inserts and
+// removes the rows that differ, and the view keeps its expansion state,
+// selection and scroll position.
+class DeviceTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+    enum class Kind
+    {
+        Computer,
+        Device,
+        Port,
+    };
+    struct Node
+    {
+        uint64_t key;
+        Kind kind;
+        DeviceGraph const* graph;
+        DeviceGraph::Index index; // of the device, or of the device plugged into the port
+        unsigned port;
+        Node* parent;
+        int row;
+        // Rows without children start out fetched, so that children added later get inserted
+        bool fetched=false;
+        std::vector<std::unique_ptr<Node>> children;
+    };
+    struct ChildSpec
+    {
+        uint64_t key;
+        Kind kind;
+        DeviceGraph const* graph;
+        DeviceGraph::Index index;
+        unsigned port;
+    };
+
+    std::shared_ptr<const DeviceGraph> tree_;
+    // The tree, or the root hubs read so far, each with its subtree
+    std::vector<std::shared_ptr<const DeviceGraph>> graphs_;
+    Node root_{0, Kind::Computer, nullptr, DeviceGraph::NONE, 0, nullptr, 0, false, {}};
+    bool portsShown_=false;
+    bool vendorProductIdsShown_=false;
+    QString findText_;
+    QFont boldFont_;
+
+    Node* nodeOf(QModelIndex const& index) const;
+    Device const* deviceOf(Node const& node) const;
+    bool hasChildSpecs(Node const& node) const;
+    QModelIndex indexOf(Node const& node) const;
+    std::vector<ChildSpec> childSpecs(Node const& node) const;
+    std::unique_ptr<Node> makeNode(ChildSpec const& spec, Node* parent, int row) const;
+    Node* fetchChild(Node& node, uint64_t key, Kind kind);
+    QModelIndex fetchRow(DeviceGraph const& graph, DeviceGraph::Index index);
+    void reconcile(Node& node);
+    void reconcileAll();
+    void setGraphs(std::shared_ptr<const DeviceGraph> tree, std::vector<std::shared_ptr<const DeviceGraph>> graphs);
+    void notifyAllChanged(Node const& node);
+    QString formatName(Device const& dev) const;
+
+public:
+    explicit DeviceTreeModel(QObject* parent=nullptr);
+    void setTree(std::shared_ptr<const DeviceGraph> tree);
+    // Shows the root hubs of a tree still being read, tree() is null until setTree
+    void setRootHubs(std::vector<std::shared_ptr<const DeviceGraph>> rootHubs);
+    std::shared_ptr<const DeviceGraph> tree() const { return tree_; }
+    std::vector<std::shared_ptr<const DeviceGraph>> const& graphs() const { return graphs_; }
+    void setShowPorts(bool enable);
+    void setShowVendorProductIds(bool enable);
+    void setFindText(QString const& text);
+    void setBoldFont(QFont const& font) { boldFont_=font; }
+    bool matchesFindText(Device const& dev) const;
+
+    // Null for the computer and port rows
+    Device const* device(QModelIndex const& index) const;
+    // Fetches the rows of the devices matching the find text, which are returned in tree order
+    std::vector<QModelIndex> fetchMatches();
+
+    QModelIndex index(int row, int column, QModelIndex const& parent=QModelIndex()) const override;
+    QModelIndex parent(QModelIndex const& index) const override;
+    int rowCount(QModelIndex const& parent=QModelIndex()) const override;
+    int columnCount(QModelIndex const& parent=QModelIndex()) const override;
+    QVariant data(QModelIndex const& index, int role=Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role=Qt::DisplayRole) const override;
+    bool hasChildren(QModelIndex const& parent=QModelIndex()) const override;
+    bool canFetchMore(QModelIndex const& parent) const override;
+    void fetchMore(QModelIndex const& parent) override;
+};
@@ -0,0 +1,108 @@
+#include "DeviceTreeReader.h"
+#include <algorithm>
+
+DeviceTreeReader::DeviceTreeReader(std::function<std::shared_ptr<const DeviceGraph>()> currentTree, QObject* parent)
+    : QObject(parent)
+    , currentTree_(std::move(currentTree))
+{
+}
+
+DeviceTreeReader::~DeviceTreeReader()
+{
+    // The result posted by the worker is dropped along with this object
+    cancelled_=true;
+    if(worker_.joinable())
+        worker_.join();
+}
+
+void DeviceTreeReader::refresh()
+{
+    refreshQueued_=true;
+    queuedPaths_.clear();
+    // The refresh looks the names up again
+    namesQueued_=false;
+    if(busy_)
+        cancelled_=true;
+    else
+        startNext();
+}
+
+void DeviceTreeReader::update(std::vector<std::string> const& sysfsPaths)
+{
+    // A queued refresh will read these devices anyway
+    if(!refreshQueued_)
+        queuedPaths_.insert(queuedPaths_.end(), sysfsPaths.begin(), sysfsPaths.end());
+    if(!busy_)
+        startNext();
+}
+
+void DeviceTreeReader::resolvePendingNames()
+{
+    if(!refreshQueued_)
+        namesQueued_=true;
+    if(!busy_)
+        startNext();
+}
+
+void DeviceTreeReader::startNext()
+{
+    if(worker_.joinable())
+        worker_.join();
+    busy_=false;
+
+    const auto tree=currentTree_();
+    if(!refreshQueued_ && ((queuedPaths_.empty() && !namesQueued_) || !tree))
+    {
+        // Nothing to update yet
+        queuedPaths_.clear();
+        namesQueued_=false;
+        return;
+    }
+
+    busy_=true;
+    cancelled_=false;
+    const auto finish=[this](DeviceGraph&& result)
+    {
+        const auto tree=std::make_shared<const DeviceGraph>(std::move(result));
+        QMetaObject::invokeMethod(this, [this, tree]{ onReadFinished(tree); }, Qt::QueuedConnection);
+    };
+    if(refreshQueued_)
+    {
+        refreshQueued_=false;
+        const auto generation=++refreshGeneration_;
+        worker_=std::thread([this, finish, generation]
+        {
+            finish(readDeviceTree([this, generation](DeviceGraph const& rootHub)
+            {
+                const auto subtree=std::make_shared<const DeviceGraph>(rootHub);
+                // Hubs of a cancelled refresh may still be queued when the next one has started
+                QMetaObject::invokeMethod(this, [this, subtree, generation]
+                                          {
+                                              if(!cancelled_ && generation==refreshGeneration_)
+                                                  emit rootHubRead(subtree, generation);
+                                          }, Qt::QueuedConnection);
+            }, &cancelled_));
+        });
+    }
+    else
+    {
+        auto paths=std::move(queuedPaths_);
+        queuedPaths_.clear();
+        const bool resolveNames=namesQueued_;
+        namesQueued_=false;
+        worker_=std::thread([this, finish, tree, paths=std::move(paths), resolveNames]() mutable
+        {
+            auto updated = paths.empty() ? DeviceGraph(*tree) : updateDeviceSubtrees(*tree, std::move(paths), &cancelled_);
+            if(resolveNames)
+                updated=::resolvePendingNames(std::move(updated));
+            finish(std::move(updated));
+        });
+    }
+}
+
+void DeviceTreeReader::onReadFinished(std::shared_ptr<const DeviceGraph> tree)
+{
+    if(!cancelled_)
+        emit treeRead(std::move(tree));
+    startNext();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <QObject>
+#include "DeviceTree.h"
+
+// Reads the device tree on a worker thread, one read at a time. A refresh
+// requested during a read cancels it and replaces everything queued, while
+// hotplug updates requested during a read are merged into one. Pending names
+// are resolved the same way, so the lookups and the cache file stay off the
+// GUI thread.
+class DeviceTreeReader : public QObject
+{
+    Q_OBJECT
+
+    std::function<std::shared_ptr<const DeviceGraph>()> currentTree_;
+    std::thread worker_;
+    CancelFlag cancelled_{false};
+    bool busy_=false;
+    bool refreshQueued_=false;
+    // Tells the root hubs of a cancelled refresh from those of the next one
+    unsigned refreshGeneration_=0;
+    std::vector<std::string> queuedPaths_;
+    bool namesQueued_=false;
+
+    void startNext();
+    void onReadFinished(std::shared_ptr<const DeviceGraph> tree);
+public:
+    // currentTree gives the tree that hotplug updates are applied to
+    explicit DeviceTreeReader(std::function<std::shared_ptr<const DeviceGraph>()> currentTree, QObject* parent=nullptr);
+    ~DeviceTreeReader();
+    void refresh();
+    void update(std::vector<std::string> const& sysfsPaths);
+    // Delivers the current tree with the pending names looked up, see NameCache::whenDatabasesLoaded
+    void resolvePendingNames();
+
+signals:
+    // A root hub with its subtree, read by the refresh in progress. A new
+    // generation means the refresh has started over.
+    void rootHubRead(std::shared_ptr<const DeviceGraph> subtree, unsigned refreshGeneration);
+    void treeRead(std::shared_ptr<const DeviceGraph> tree);
+};
@@ -1,154 +1,124 @@
 #include "DeviceTreeWidget.h"
-#include <iostream>
 #include <QHeaderView>
+#include <QItemSelectionModel>
 #include "Device.h"
+#include "DeviceTreeModel.h"
 
-namespace
+DeviceTreeWidget::DeviceTreeWidget(QWidget* parent)
+    : QTreeView(parent)
+    , model_(new DeviceTreeModel(this))
 {
+    auto boldFont(font());
+    boldFont.setBold(true);
+    model_->setBoldFont(boldFont);
+    setModel(model_);
+    setUniformRowHeights(true);
+    header()->setStretchLastSection(false);
+    // Fitting the column to all the rows would format every label on each update
+    header()->setResizeContentsPrecision(0);
+    // Show the buses expanded as they come. Deeper rows keep what the user chose,
+    // and aren't fetched until expanded.
+    connect(model_, &DeviceTreeModel::rowsInserted, this, &DeviceTreeWidget::onRowsInserted);
+    expand(model_->index(0, 0));
+    connect(selectionModel(), &QItemSelectionModel::selectionChanged, this, [this]
+            {
+                if(!updating_) onSelectionChanged();
+            });
+}
 
-enum
+void DeviceTreeWidget::onRowsInserted(QModelIndex const& parent, const int first, const int last)
 {
-    DeviceRole=Qt::UserRole+0,
-};
+    // The computer and the root hubs
+    constexpr int autoExpandedLevels=2;
+    int level=0;
+    for(auto index=parent; index.isValid(); index=index.parent())
+        ++level;
+    if(level>=autoExpandedLevels) return;
+    for(int row=first; row<=last; ++row)
+        expand(model_->index(row, 0, parent));
+}
 
-void setDevice(QTreeWidgetItem*const item, Device*const dev)
+Device const* DeviceTreeWidget::selectedDevice() const
 {
-    item->setData(0,DeviceRole,reinterpret_cast<unsigned long long>(dev));
+    const auto selected=selectionModel()->selectedIndexes();
+    if(selected.isEmpty()) return nullptr;
+    return model_->device(selected[0]);
 }
 
-Device* getDevice(QTreeWidgetItem const*const item)
+void DeviceTreeWidget::updateModel(std::function<void()> const& update)
 {
-    const auto data=static_cast<uintptr_t>(item->data(0,DeviceRole).toULongLong());
-    return reinterpret_cast<Device*>(data);
-}
+    // Removing the selected row would report the selection in the middle of the update
+    updating_=true;
+    update();
+    updating_=false;
+
+    // The properties view must not keep pointing into the old tree
+    if(selectedDevice()!=selectedDevice_)
+        onSelectionChanged();
 
+    // Only measures the visible rows, see the constructor
+    resizeColumnToContents(0);
+    emit treeUpdated();
 }
 
-DeviceTreeWidget::DeviceTreeWidget(QWidget* parent)
-    : QTreeWidget(parent)
+void DeviceTreeWidget::setTree(DeviceGraph&& tree)
 {
-    setHeaderLabel("USB devices");
-    header()->setStretchLastSection(false);
-    connect(this, &QTreeWidget::itemSelectionChanged, this, &DeviceTreeWidget::onSelectionChanged);
+    setTree(std::make_shared<const DeviceGraph>(std::move(tree)));
 }
 
-QString DeviceTreeWidget::formatName(Device const& dev) const
+void DeviceTreeWidget::setTree(std::shared_ptr<const DeviceGraph> tree)
 {
-    if(wantVenProdIdsShown_)
-        return QString("%1:%2 %3").arg(dev.vendorId, 4, 16, QLatin1Char('0'))
-                                  .arg(dev.productId, 4, 16, QLatin1Char('0'))
-                                  .arg(dev.name);
-    else
-        return dev.name;
+    // The old tree has to live until selectedDevice_ has been moved off it
+    const auto oldGraphs=model_->graphs();
+    updateModel([&]{ model_->setTree(std::move(tree)); });
 }
 
-void DeviceTreeWidget::insertChildren(QTreeWidgetItem* item, Device const* dev)
+void DeviceTreeWidget::setRootHubs(std::vector<std::shared_ptr<const DeviceGraph>> rootHubs)
 {
-    auto boldFont(font());
-    boldFont.setBold(true);
-    if(wantPortsShown_ && dev->maxChildren)
-    {
-        // dev is a hub, show all its ports between the hub and the children
-        for(unsigned port=1; port <= dev->maxChildren; ++port)
-        {
-            const auto portItem=new QTreeWidgetItem{QStringList{QString("[Port %1]").arg(port)}};
-            item->addChild(portItem);
-            const auto child=std::find_if(dev->children.begin(),dev->children.end(),
-                                          [port](const auto& child) { return child->port == port; });
-            if(child==dev->children.end())
-                continue;
-            const auto childItem=new QTreeWidgetItem{QStringList{formatName(**child)}};
-            setDevice(childItem, child->get());
-            portItem->addChild(childItem);
-            if(!(*child)->isHub())
-                childItem->setData(0, Qt::FontRole, boldFont);
-            insertChildren(childItem, child->get());
-            if((*child)->uniqueAddress==currentSelectionUniqueAddress_)
-                childItem->setSelected(true);
-        }
-    }
-    else
-    {
-        for(const auto& childDev : dev->children)
-        {
-            const auto childItem=new QTreeWidgetItem{QStringList{formatName(*childDev)}};
-            setDevice(childItem, childDev.get());
-            item->addChild(childItem);
-            if(!childDev->isHub())
-                childItem->setData(0, Qt::FontRole, boldFont);
-            insertChildren(childItem, childDev.get());
-            if(childDev->uniqueAddress==currentSelectionUniqueAddress_)
-                childItem->setSelected(true);
-        }
-    }
+    const auto oldGraphs=model_->graphs();
+    updateModel([&]{ model_->setRootHubs(std::move(rootHubs)); });
 }
 
-void DeviceTreeWidget::updateDeviceTree()
+std::shared_ptr<const DeviceGraph> DeviceTreeWidget::tree() const
 {
-    {
-        // Clearing will invoke the signal, which we don't want to actually
-        // take effect now, so we simply save and restore the value.
-        const auto oldSelectionAddr=currentSelectionUniqueAddress_;
-        clear();
-        currentSelectionUniqueAddress_=oldSelectionAddr;
-    }
-
-    const auto rootItem=new QTreeWidgetItem{QStringList{"Computer"}};
-    addTopLevelItem(rootItem);
-    for(const auto& dev : deviceTree_)
-    {
-        const auto topLevelItem=new QTreeWidgetItem{QStringList{formatName(*dev)}};
-        setDevice(topLevelItem, dev.get());
-        rootItem->addChild(topLevelItem);
-        insertChildren(topLevelItem, dev.get());
-        if(dev->uniqueAddress==currentSelectionUniqueAddress_)
-            topLevelItem->setSelected(true);
-    }
-    expandAll();
-
-    resizeColumnToContents(0);
-    emit treeUpdated();
+    return model_->tree();
 }
 
-void DeviceTreeWidget::setTree(std::vector<std::unique_ptr<Device>>&& tree)
+void DeviceTreeWidget::setFindText(QString const& text)
 {
-    deviceTree_=std::move(tree);
-    updateDeviceTree();
+    model_->setFindText(text.trimmed());
+    const auto matches=model_->fetchMatches();
+    for(const auto& match : matches)
+    {
+        for(auto parent=match.parent(); parent.isValid(); parent=parent.parent())
+            expand(parent);
+    }
+    if(!matches.empty())
+        scrollTo(matches.front());
 }
 
 QSize DeviceTreeWidget::sizeHint() const
 {
     // FIXME: dunno what size exactly we need to avoid scrollbars. Will request a bit larger than the section size.
-    return QSize(header()->sectionSize(0)*1.05, QTreeWidget::sizeHint().height());
+    return QSize(header()->sectionSize(0)*1.05, QTreeView::sizeHint().height());
 }
 
 void DeviceTreeWidget::setShowPorts(const bool enable)
 {
-    wantPortsShown_=enable;
-    updateDeviceTree();
+    updateModel([&]{ model_->setShowPorts(enable); });
 }
 void DeviceTreeWidget::setShowVendorProductIds(const bool enable)
 {
-    wantVenProdIdsShown_=enable;
-    updateDeviceTree();
+    updateModel([&]{ model_->setShowVendorProductIds(enable); });
 }
 
 void DeviceTreeWidget::onSelectionChanged()
 {
-    const auto selected=selectedItems();
-    if(selected.isEmpty())
-    {
-        currentSelectionUniqueAddress_=INVALID_UNIQUE_DEVICE_ADDRESS;
-        emit devicesUnselected();
-        return;
-    }
-    const auto device=getDevice(selected[0]);
-    if(!device)
+    selectedDevice_=selectedDevice();
+    if(!selectedDevice_)
     {
-        currentSelectionUniqueAddress_=INVALID_UNIQUE_DEVICE_ADDRESS;
         emit devicesUnselected();
         return;
     }
-    currentSelectionUniqueAddress_=device->uniqueAddress;
-    emit deviceSelected(device);
+    emit deviceSelected(selectedDevice_);
 }
@@ -1,34 +1,41 @@
 #pragma once
 
-#include <stdint.h>
+#include <functional>
 #include <memory>
-#include <QTreeWidget>
-#include "Device.h"
+#include <vector>
+#include <QTreeView>
+#include "DeviceGraph.h"
 
-class DeviceTreeWidget : public QTreeWidget
+class DeviceTreeModel;
+class DeviceTreeWidget : public QTreeView
 {
     Q_OBJECT
 
-    bool wantPortsShown_=false;
-    bool wantVenProdIdsShown_=false;
-    UniqueDeviceAddress currentSelectionUniqueAddress_=INVALID_UNIQUE_DEVICE_ADDRESS;
-    std::vector<std::unique_ptr<Device>> deviceTree_;
+    DeviceTreeModel* model_;
+    // What deviceSelected has last been emitted with, it must not keep pointing into an old tree
+    Device const* selectedDevice_=nullptr;
+    bool updating_=false;
 
-    void insertChildren(QTreeWidgetItem* item, Device const* dev);
-    QString formatName(Device const& dev) const;
+    Device const* selectedDevice() const;
+    void updateModel(std::function<void()> const& update);
+    void onRowsInserted(QModelIndex const& parent, int first, int last);
     void onSelectionChanged();
-    void updateDeviceTree();
-    void onItemSelectionChanged();
 
 public:
     DeviceTreeWidget(QWidget* parent=nullptr);
-    void setTree(std::vector<std::unique_ptr<Device>>&& tree);
+    void setTree(DeviceGraph&& tree);
+    void setTree(std::shared_ptr<const DeviceGraph> tree);
+    // Shows the root hubs of a tree still being read, tree() is null until setTree
+    void setRootHubs(std::vector<std::shared_ptr<const DeviceGraph>> rootHubs);
+    // Highlights the devices whose names or IDs contain the text, and expands the hubs above them
+    void setFindText(QString const& text);
+    std::shared_ptr<const DeviceGraph> tree() const;
     void setShowPorts(bool enable);
     void setShowVendorProductIds(bool enable);
     QSize sizeHint() const override;
 
 signals:
-    void deviceSelected(Device*);
+    void deviceSelected(Device const*);
     void devicesUnselected();
     void treeUpdated();
 };
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <QString>
+
+// Problems met while reading a device. Readers substitute empty values instead
+// of failing, so the device stays in the tree with whatever could be read.
+using Diagnostics=std::vector<QString>;
+
+struct DiagnosticCounters
+{
+    std::atomic<unsigned long> missingAttributes{0};
+    std::atomic<unsigned long> parseFailures{0};
+    std::atomic<unsigned long> vanishedDevices{0};
+};
+
+// Totals since startup
+inline DiagnosticCounters diagnosticCounters;
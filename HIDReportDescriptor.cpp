@@ -4,8 +4,11 @@
 #include <deque>
 #include <cassert>
 #include <optional>
-#include <QFont>
-#include <QTreeWidgetItem>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <QObject>
 #include "util.hpp"
 
 namespace
@@ -573,17 +576,15 @@ void check(const bool correct)
     if(!correct) throw std::invalid_argument("HID report check failed");
 }
 
-void addReportsTreeItem(QTreeWidgetItem*const root, std::vector<ReportStructure> const& reports, QString const& label)
+void addReportsRow(HIDDescriptorRow& root, std::vector<ReportStructure> const& reports, QString const& label)
 {
-    const auto reportsItem=new QTreeWidgetItem{{label}};
-    root->addChild(reportsItem);
+    auto& reportsRow=root.children.emplace_back(label);
     for(const auto& report : reports)
     {
-        const auto repItem=new QTreeWidgetItem{{report.reportId ? QString("0x%1").arg(*report.reportId, 2,16,QChar('0'))
-                                                                : QObject::tr("Without Report ID")}};
-        reportsItem->addChild(repItem);
+        auto& repRow=reportsRow.children.emplace_back(report.reportId ? QString("0x%1").arg(*report.reportId, 2,16,QChar('0'))
+                                                                      : QObject::tr("Without Report ID"));
         if(report.reportId)
-            repItem->addChild(new QTreeWidgetItem{{QObject::tr("Report ID: 0x%1").arg(*report.reportId, 2,16,QChar('0'))}});
+            repRow.children.emplace_back(QObject::tr("Report ID: 0x%1").arg(*report.reportId, 2,16,QChar('0')));
         for(const auto elem : report.elements)
         {
             if(!elem.usages.empty() || elem.usageMin)
@@ -620,21 +621,21 @@ void addReportsTreeItem(QTreeWidgetItem*const root, std::vector<ReportStructure>
                                                             .arg(usageName(*elem.usageMax,IncludeHex{}));
                     if(possibleUsages.endsWith(", "))
                         possibleUsages.chop(2);
-                    repItem->addChild(new QTreeWidgetItem{{QObject::tr("%1-element array of %2-bit items, possible usages: %3")
-                                                          .arg(elem.multiplicity)
-                                                          .arg(elem.bitSize)
-                                                          .arg(possibleUsages)}});
+                    repRow.children.emplace_back(QObject::tr("%1-element array of %2-bit items, possible usages: %3")
+                                                 .arg(elem.multiplicity)
+                                                 .arg(elem.bitSize)
+                                                 .arg(possibleUsages));
                 }
                 else
                 {
-                    repItem->addChild(new QTreeWidgetItem{{QObject::tr("%1-bit data, usage: %2")
-                                                          .arg(elem.bitSize)
-                                                          .arg(usageName(elem.usages[0], IncludeHex{false}, ShowPage{true}))}});
+                    repRow.children.emplace_back(QObject::tr("%1-bit data, usage: %2")
+                                                 .arg(elem.bitSize)
+                                                 .arg(usageName(elem.usages[0], IncludeHex{false}, ShowPage{true})));
                 }
             }
             else
             {
-                repItem->addChild(new QTreeWidgetItem{{QObject::tr("%1-bit padding").arg(elem.bitSize*elem.multiplicity)}});
+                repRow.children.emplace_back(QObject::tr("%1-bit padding").arg(elem.bitSize*elem.multiplicity));
             }
         }
     }
@@ -642,19 +643,19 @@ void addReportsTreeItem(QTreeWidgetItem*const root, std::vector<ReportStructure>
 
 }
 
-void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont, std::vector<uint8_t> const& data)
+HIDDescriptorRows parseHIDReportDescriptor(const ByteView data)
 {
-    auto boldFont(baseFont);
-    boldFont.setBold(true);
-
-    auto descriptorDetailsItem=new QTreeWidgetItem{{QObject::tr("Detailed view")}};
-    root->addChild(descriptorDetailsItem);
+    HIDDescriptorRows rows;
+    // The details row must stay put while the reports row is added
+    rows.reserve(2);
+    auto descriptorDetailsRow=&rows.emplace_back(QObject::tr("Detailed view"));
     std::vector<ReportStructure> reportsIn, reportsOut, reportsFeat;
     try
     {
         std::stack<DescriptionState> dscStates;
         dscStates.push({});
-        std::stack<QTreeWidgetItem*> prevRoots;
+        // Rows are only added to the innermost collection, so the outer ones don't move
+        std::stack<HIDDescriptorRow*> prevRoots;
         for(unsigned i=0; i<data.size();)
         {
             const auto head=data[i];
@@ -669,7 +670,7 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
                     str+=QString(" %1").arg(data.at(i+3+k), 2,16,QChar('0'));
                 str += " (Long)";
 
-                descriptorDetailsItem->addChild(new QTreeWidgetItem{{str}});
+                descriptorDetailsRow->children.emplace_back(str);
                 i += dataSize+3;
                 continue;
             }
@@ -683,8 +684,7 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
             const QString types[]={QObject::tr("Main"), QObject::tr("Global"), QObject::tr("Local"), QObject::tr("Reserved")};
             str += QString(" (%1)").arg(types[type]);
 
-            auto item=new QTreeWidgetItem{{str}};
-            descriptorDetailsItem->addChild(item);
+            auto& item=descriptorDetailsRow->children.emplace_back(str);
             const auto tag=head>>4;
             // NOTE: we've already checked above that we don't overflow data.size()
             const auto dataValueS = getItemDataSigned(data.data()+i+1, dataSize);
@@ -698,8 +698,8 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
                 case MIT_OUTPUT:
                 case MIT_FEATURE:
                 {
-                    item->setData(1, Qt::DisplayRole, formatInOutFeatItem(static_cast<MainItemTag>(tag), dataValueU));
-                    item->setData(1, Qt::FontRole, boldFont);
+                    item.value=formatInOutFeatItem(static_cast<MainItemTag>(tag), dataValueU);
+                    item.boldValue=true;
                     auto& reports = tag==MIT_INPUT ? reportsIn
                                   : tag==MIT_OUTPUT ? reportsOut
                                   :                   reportsFeat;
@@ -742,21 +742,20 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
                             typeStr=QObject::tr("Vendor-defined type 0x%1").arg(dataValueU, 2, 16, QChar('0'));
                         break;
                     }
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Collection (%1)").arg(typeStr));
-                    prevRoots.push(descriptorDetailsItem);
-                    descriptorDetailsItem->addChild(item);
-                    descriptorDetailsItem=item;
+                    item.value=QObject::tr("Collection (%1)").arg(typeStr);
+                    prevRoots.push(descriptorDetailsRow);
+                    descriptorDetailsRow=&item;
                     dscStates.top().local.clear();
                     break;
                 }
                 case MIT_END_COLLECTION:
                     if(prevRoots.empty())
                     {
-                        item->setData(1, Qt::DisplayRole, QObject::tr("*** Stray End Collection"));
+                        item.value=QObject::tr("*** Stray End Collection");
                         break;
                     }
-                    item->setData(1, Qt::DisplayRole, QObject::tr("End Collection"));
-                    descriptorDetailsItem=prevRoots.top();
+                    item.value=QObject::tr("End Collection");
+                    descriptorDetailsRow=prevRoots.top();
                     prevRoots.pop();
 
                     dscStates.top().closeCollection();
@@ -767,52 +766,52 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
                 switch(tag)
                 {
                 case GIT_USAGE_PAGE:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Usage Page: %1").arg(usagePageName(dataValueU)));
+                    item.value=QObject::tr("Usage Page: %1").arg(usagePageName(dataValueU));
                     dscStates.top().global.usagePage=dataValueU;
                     break;
                 case GIT_LOG_MIN:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Logical Minimum: %1").arg(dataValueS));
+                    item.value=QObject::tr("Logical Minimum: %1").arg(dataValueS);
                     dscStates.top().global.logicalMin=dataValueS;
                     break;
                 case GIT_LOG_MAX:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Logical Maximum: %1").arg(dataValueS));
+                    item.value=QObject::tr("Logical Maximum: %1").arg(dataValueS);
                     dscStates.top().global.logicalMax=dataValueS;
                     break;
                 case GIT_PHYS_MIN:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Physical Minimum: %1").arg(dataValueS));
+                    item.value=QObject::tr("Physical Minimum: %1").arg(dataValueS);
                     dscStates.top().global.physicalMin=dataValueS;
                     break;
                 case GIT_PHYS_MAX:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Physical Maximum: %1").arg(dataValueS));
+                    item.value=QObject::tr("Physical Maximum: %1").arg(dataValueS);
                     dscStates.top().global.physicalMax=dataValueS;
                     break;
                 case GIT_UNIT_EXP:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Unit Exponent: %1").arg(dataValueS));
+                    item.value=QObject::tr("Unit Exponent: %1").arg(dataValueS);
                     dscStates.top().global.unitExp=dataValueS;
                     break;
                 case GIT_UNIT:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Unit"));
+                    item.value=QObject::tr("Unit");
                     dscStates.top().global.unit=dataValueU;
                     break;
                 case GIT_REP_SIZE:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Report Size: %1").arg(dataValueU));
+                    item.value=QObject::tr("Report Size: %1").arg(dataValueU);
                     dscStates.top().global.reportSize=dataValueU;
                     break;
                 case GIT_REP_ID:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Report ID: 0x%1").arg(dataValueU, 2, 16, QChar('0')));
+                    item.value=QObject::tr("Report ID: 0x%1").arg(dataValueU, 2, 16, QChar('0'));
                     check(dataValueU<256);
                     dscStates.top().global.reportId=dataValueU;
                     break;
                 case GIT_REP_COUNT:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Report Count: %1").arg(dataValueU));
+                    item.value=QObject::tr("Report Count: %1").arg(dataValueU);
                     dscStates.top().global.reportCount=dataValueU;
                     break;
                 case GIT_PUSH:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Push"));
+                    item.value=QObject::tr("Push");
                     dscStates.push(dscStates.top());
                     break;
                 case GIT_POP:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Pop"));
+                    item.value=QObject::tr("Pop");
                     check(dscStates.size()>1);
                     dscStates.pop();
                     break;
@@ -824,71 +823,71 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
                 case LIT_USAGE:
                     if(dataSize>2)
                     {
-                        item->setData(1, Qt::DisplayRole, QObject::tr("Usage: %1").arg(usageName(dataValueU, IncludeHex{false}, ShowPage{})));
+                        item.value=QObject::tr("Usage: %1").arg(usageName(dataValueU, IncludeHex{false}, ShowPage{}));
                         dscStates.top().local.usages.push_back(dataValueU);
                     }
                     else
                     {
                         const auto page = dscStates.top().global.usagePage.value();
                         const auto usage = uint32_t(page)<<16 | dataValueU;
-                        item->setData(1, Qt::DisplayRole, QObject::tr("Usage: %1").arg(usageName(usage, IncludeHex{false}, ShowPage{false})));
+                        item.value=QObject::tr("Usage: %1").arg(usageName(usage, IncludeHex{false}, ShowPage{false}));
                         dscStates.top().local.usages.push_back(usage);
                     }
                     break;
                 case LIT_USAGE_MIN:
                     if(dataSize>2)
                     {
-                        item->setData(1, Qt::DisplayRole, QObject::tr("Usage Minimum: %1").arg(usageName(dataValueU, IncludeHex{})));
+                        item.value=QObject::tr("Usage Minimum: %1").arg(usageName(dataValueU, IncludeHex{}));
                         dscStates.top().local.usageMin=dataValueU;
                     }
                     else
                     {
                         const auto page = dscStates.top().global.usagePage.value();
                         const auto usage = uint32_t(page)<<16 | dataValueU;
-                        item->setData(1, Qt::DisplayRole, QObject::tr("Usage Minimum: %1").arg(usageName(usage, IncludeHex{})));
+                        item.value=QObject::tr("Usage Minimum: %1").arg(usageName(usage, IncludeHex{}));
                         dscStates.top().local.usageMin = uint32_t(page)<<16 | dataValueU;
                     }
                     break;
                 case LIT_USAGE_MAX:
                     if(dataSize>2)
                     {
-                        item->setData(1, Qt::DisplayRole, QObject::tr("Usage Maximum: %1").arg(usageName(dataValueU, IncludeHex{})));
+                        item.value=QObject::tr("Usage Maximum: %1").arg(usageName(dataValueU, IncludeHex{}));
                         dscStates.top().local.usageMax=dataValueU;
                     }
                     else
                     {
                         const auto page = dscStates.top().global.usagePage.value();
                         const auto usage = uint32_t(page)<<16 | dataValueU;
-                        item->setData(1, Qt::DisplayRole, QObject::tr("Usage Maximum: %1").arg(usageName(usage, IncludeHex{})));
+                        item.value=QObject::tr("Usage Maximum: %1").arg(usageName(usage, IncludeHex{}));
                         dscStates.top().local.usageMax = uint32_t(page)<<16 | dataValueU;
                     }
                     break;
                 case LIT_DESIG_IDX:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Designator Index: %1").arg(dataValueU));
+                    item.value=QObject::tr("Designator Index: %1").arg(dataValueU);
                     dscStates.top().local.designatorIndex=dataValueU;
                     break;
                 case LIT_DESIG_MIN:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Designator Minimum: 0x%1").arg(dataValueU, 2, 16, QChar('0')));
+                    item.value=QObject::tr("Designator Minimum: 0x%1").arg(dataValueU, 2, 16, QChar('0'));
                     dscStates.top().local.designatorMin=dataValueU;
                     break;
                 case LIT_DESIG_MAX:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Designator Maximum: 0x%1").arg(dataValueU, 2, 16, QChar('0')));
+                    item.value=QObject::tr("Designator Maximum: 0x%1").arg(dataValueU, 2, 16, QChar('0'));
                     dscStates.top().local.designatorMax=dataValueU;
                     break;
                 case LIT_STRING_IDX:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("String Index: %1").arg(dataValueU));
+                    item.value=QObject::tr("String Index: %1").arg(dataValueU);
                     dscStates.top().local.stringIndex=dataValueU;
                     break;
                 case LIT_STR_MIN:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("String Minimum: %1").arg(dataValueU));
+                    item.value=QObject::tr("String Minimum: %1").arg(dataValueU);
                     dscStates.top().local.stringMin=dataValueU;
                     break;
                 case LIT_STR_MAX:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("String Maximum: %1").arg(dataValueU));
+                    item.value=QObject::tr("String Maximum: %1").arg(dataValueU);
                     dscStates.top().local.stringMax=dataValueU;
                     break;
                 case LIT_DELIM:
-                    item->setData(1, Qt::DisplayRole, QObject::tr("Delimiter: %1").arg(dataValueU));
+                    item.value=QObject::tr("Delimiter: %1").arg(dataValueU);
                     break;
                 }
                 break;
@@ -897,21 +896,60 @@ void parseHIDReportDescriptor(QTreeWidgetItem*const root, QFont const& baseFont,
             i += dataSize+1;
         }
 
-        const auto reportsItem=new QTreeWidgetItem{{QObject::tr("Supported reports")}};
-        root->addChild(reportsItem);
+        auto& reportsRow=rows.emplace_back(QObject::tr("Supported reports"));
         if(!reportsIn.empty())
-            addReportsTreeItem(reportsItem,reportsIn,QObject::tr("Input reports"));
+            addReportsRow(reportsRow,reportsIn,QObject::tr("Input reports"));
         if(!reportsOut.empty())
-            addReportsTreeItem(reportsItem,reportsOut,QObject::tr("Output reports"));
+            addReportsRow(reportsRow,reportsOut,QObject::tr("Output reports"));
         if(!reportsFeat.empty())
-            addReportsTreeItem(reportsItem,reportsFeat,QObject::tr("Feature reports"));
+            addReportsRow(reportsRow,reportsFeat,QObject::tr("Feature reports"));
     }
     catch(std::out_of_range const&)
     {
-        descriptorDetailsItem->addChild(new QTreeWidgetItem{{QObject::tr("(broken item: too few bytes)")}});
+        descriptorDetailsRow->children.emplace_back(QObject::tr("(broken item: too few bytes)"));
     }
     catch(std::bad_optional_access const&)
     {
-        descriptorDetailsItem->addChild(new QTreeWidgetItem{{QObject::tr("(broken item: some fields missing)")}});
+        descriptorDetailsRow->children.emplace_back(QObject::tr("(broken item: some fields missing)"));
+    }
+    return rows;
+}
+
+std::shared_ptr<const HIDDescriptorRows> parseHIDReportDescriptor(std::shared_ptr<const std::vector<uint8_t>> const& data)
+{
+    // Identical devices share one interned descriptor buffer, so the recently
+    // decoded buffers are remembered. Entries hold their buffers, thus a key
+    // can't be reused by another buffer while it's in the cache.
+    struct Entry
+    {
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        std::shared_ptr<const HIDDescriptorRows> rows;
+    };
+    constexpr std::size_t capacity=64;
+    // Most recently used first
+    static std::list<Entry> cache;
+    static std::mutex mutex;
+    const auto find=[&data]
+    {
+        const auto it=std::find_if(cache.begin(), cache.end(), [&data](Entry const& e){ return e.data==data; });
+        if(it==cache.end()) return std::shared_ptr<const HIDDescriptorRows>{};
+        cache.splice(cache.begin(), cache, it);
+        return it->rows;
+    };
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if(auto rows=find())
+            return rows;
     }
+    auto rows=std::make_shared<const HIDDescriptorRows>(parseHIDReportDescriptor(ByteView(*data)));
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    // Another thread may have decoded the same buffer meanwhile, then its result is used
+    if(auto earlier=find())
+        return earlier;
+    cache.push_front({data, rows});
+    if(cache.size()>capacity)
+        cache.pop_back();
+    return rows;
 }
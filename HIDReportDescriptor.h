@@ -1,7 +1,23 @@
 #pragma once
 
-#include <vector>
 #include <stdint.h>
-class QTreeWidgetItem;
-class QFont;
-void parseHIDReportDescriptor(QTreeWidgetItem* root, QFont const& baseFont, std::vector<uint8_t> const& data);
+#include <memory>
+#include <vector>
+#include <QString>
+#include "ByteView.hpp"
+
+// Plain data, so that descriptors can be decoded off the GUI thread
+struct HIDDescriptorRow
+{
+    QString text;
+    QString value;
+    bool boldValue=false;
+    std::vector<HIDDescriptorRow> children;
+
+    explicit HIDDescriptorRow(QString text) : text(std::move(text)) {}
+};
+using HIDDescriptorRows=std::vector<HIDDescriptorRow>;
+
+HIDDescriptorRows parseHIDReportDescriptor(ByteView data);
+// Returns the earlier result for the same interned buffer if it's still cached. Thread-safe.
+std::shared_ptr<const HIDDescriptorRows> parseHIDReportDescriptor(std::shared_ptr<const std::vector<uint8_t>> const& data);
@@ -0,0 +1,81 @@
+#include "HotplugMonitor.h"
+#include <iostream>
+#include <libudev.h>
+#include <QTimer>
+#include <QSocketNotifier>
+
+namespace
+{
+// Long enough to catch all the events of a hub with its children being plugged in or powered up
+constexpr int COALESCE_INTERVAL_MS=250;
+}
+
+HotplugMonitor::HotplugMonitor(QObject* parent)
+    : QObject(parent)
+    , coalesceTimer_(new QTimer(this))
+{
+    coalesceTimer_->setSingleShot(true);
+    coalesceTimer_->setInterval(COALESCE_INTERVAL_MS);
+    connect(coalesceTimer_, &QTimer::timeout, this, &HotplugMonitor::onCoalesceTimeout);
+
+    udev_=udev_new();
+    if(!udev_)
+    {
+        std::cerr << "Warning: failed to create udev context, hotplug monitoring is disabled\n";
+        return;
+    }
+    // Listen to events already processed by udev, so that the device nodes exist when we look for them
+    monitor_=udev_monitor_new_from_netlink(udev_, "udev");
+    if(!monitor_ ||
+       udev_monitor_filter_add_match_subsystem_devtype(monitor_, "usb", nullptr) < 0 ||
+       udev_monitor_enable_receiving(monitor_) < 0)
+    {
+        std::cerr << "Warning: failed to set up udev monitor, hotplug monitoring is disabled\n";
+        return;
+    }
+    notifier_=new QSocketNotifier(udev_monitor_get_fd(monitor_), QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated, this, &HotplugMonitor::onUdevEvent);
+}
+
+HotplugMonitor::~HotplugMonitor()
+{
+    if(monitor_)
+        udev_monitor_unref(monitor_);
+    if(udev_)
+        udev_unref(udev_);
+}
+
+void HotplugMonitor::onUdevEvent()
+{
+    while(const auto dev=udev_monitor_receive_device(monitor_))
+    {
+        const auto syspath=udev_device_get_syspath(dev);
+        const auto devtype=udev_device_get_devtype(dev);
+        if(syspath && devtype)
+        {
+            const std::string path=syspath;
+            if(std::string(devtype)=="usb_device")
+            {
+                changedPaths_.insert(path);
+            }
+            else if(std::string(devtype)=="usb_interface")
+            {
+                // Interfaces are shown as part of their device
+                const auto slash=path.rfind('/');
+                if(slash!=path.npos)
+                    changedPaths_.insert(path.substr(0, slash));
+            }
+        }
+        udev_device_unref(dev);
+    }
+    // Restarting the timer on each event makes a burst result in a single update
+    if(!changedPaths_.empty())
+        coalesceTimer_->start();
+}
+
+void HotplugMonitor::onCoalesceTimeout()
+{
+    const std::vector<std::string> paths(changedPaths_.begin(), changedPaths_.end());
+    changedPaths_.clear();
+    emit devicesChanged(paths);
+}
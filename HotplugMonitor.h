@@ -0,0 +1,31 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <QObject>
+
+struct udev;
+struct udev_monitor;
+class QTimer;
+class QSocketNotifier;
+class HotplugMonitor : public QObject
+{
+    Q_OBJECT
+
+    udev* udev_=nullptr;
+    udev_monitor* monitor_=nullptr;
+    QSocketNotifier* notifier_=nullptr;
+    QTimer* coalesceTimer_;
+    std::set<std::string> changedPaths_;
+
+    void onUdevEvent();
+    void onCoalesceTimeout();
+public:
+    HotplugMonitor(QObject* parent=nullptr);
+    ~HotplugMonitor();
+
+signals:
+    // Canonical sysfs paths of the USB devices that have been added, removed or changed
+    void devicesChanged(std::vector<std::string> const& sysfsPaths);
+};
@@ -0,0 +1,59 @@
+#include "InternedString.h"
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+namespace
+{
+
+struct Pool
+{
+    std::mutex mutex;
+    // Keyed by views into the owned strings, whose addresses don't change on rehashing
+    std::unordered_map<std::string_view, std::unique_ptr<std::string>> strings;
+};
+
+Pool& pool()
+{
+    static Pool pool;
+    return pool;
+}
+
+}
+
+InternedString::InternedString(const std::string_view str)
+{
+    if(str.empty()) return;
+    auto& pool=::pool();
+    std::lock_guard lock(pool.mutex);
+    auto it=pool.strings.find(str);
+    if(it==pool.strings.end())
+    {
+        auto owned=std::make_unique<std::string>(str);
+        const std::string_view key(*owned);
+        it=pool.strings.emplace(key, std::move(owned)).first;
+    }
+    str_=it->second.get();
+}
+
+InternedString InternedString::fromQString(QString const& str)
+{
+    const auto utf8=str.toUtf8();
+    return InternedString(std::string_view(utf8.data(), utf8.size()));
+}
+
+QString InternedString::toQString() const
+{
+    if(!str_) return {};
+    return QString::fromUtf8(str_->data(), str_->size());
+}
+
+InternedString::PoolStats InternedString::poolStats()
+{
+    auto& pool=::pool();
+    std::lock_guard lock(pool.mutex);
+    PoolStats stats{pool.strings.size(), 0};
+    for(const auto& [view, str] : pool.strings)
+        stats.textBytes+=view.size();
+    return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <QString>
+
+// An immutable UTF-8 string stored once per distinct value in a global pool,
+// which lives until exit. Meant for values that repeat across devices, like
+// drivers and model names. Copying and comparing costs as much as for a
+// pointer. Empty strings are null.
+class InternedString
+{
+    std::string const* str_=nullptr;
+public:
+    InternedString()=default;
+    // Thread-safe
+    explicit InternedString(std::string_view str);
+    explicit InternedString(const char* str) : InternedString(str ? std::string_view(str) : std::string_view()) {}
+    static InternedString fromQString(QString const& str);
+
+    bool isNull() const { return !str_; }
+    std::string_view view() const { return str_ ? std::string_view(*str_) : std::string_view(); }
+    // For display, the only place where it should be needed
+    QString toQString() const;
+
+    bool operator==(InternedString other) const { return str_==other.str_; }
+    bool operator!=(InternedString other) const { return str_!=other.str_; }
+
+    struct PoolStats
+    {
+        std::size_t distinct;  // strings in the pool
+        std::size_t textBytes; // their total length
+    };
+    static PoolStats poolStats();
+};
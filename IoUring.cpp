@@ -0,0 +1,277 @@
+#include "IoUring.h"
+#include <atomic>
+#include <memory>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace
+{
+
+// Same as for SysfsDir: text attributes are at most a page long
+constexpr unsigned ATTRIBUTE_BUFFER_SIZE=4096;
+constexpr unsigned RING_ENTRIES=128;
+
+std::atomic<bool> ioUringUnusable{false};
+
+class Ring
+{
+    int fd_=-1;
+    void* sqRing_=MAP_FAILED;
+    void* cqRing_=MAP_FAILED;
+    io_uring_sqe* sqes_=static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqRingSize_=0, cqRingSize_=0, sqesSize_=0;
+
+    unsigned* sqHead_=nullptr;
+    unsigned* sqTail_=nullptr;
+    unsigned* sqArray_=nullptr;
+    unsigned sqMask_=0;
+    unsigned sqEntries_=0;
+    unsigned* cqHead_=nullptr;
+    unsigned* cqTail_=nullptr;
+    io_uring_cqe* cqes_=nullptr;
+    unsigned cqMask_=0;
+
+    unsigned pendingSubmissions_=0;
+public:
+    Ring()
+    {
+        io_uring_params params{};
+        fd_=syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+        if(fd_<0) return;
+
+        sqRingSize_=params.sq_off.array+params.sq_entries*sizeof(unsigned);
+        cqRingSize_=params.cq_off.cqes+params.cq_entries*sizeof(io_uring_cqe);
+        const bool singleMap=params.features & IORING_FEAT_SINGLE_MMAP;
+        if(singleMap)
+            sqRingSize_=cqRingSize_=std::max(sqRingSize_, cqRingSize_);
+        sqRing_=mmap(nullptr, sqRingSize_, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if(sqRing_==MAP_FAILED) return;
+        if(singleMap)
+            cqRing_=sqRing_;
+        else
+            cqRing_=mmap(nullptr, cqRingSize_, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if(cqRing_==MAP_FAILED) return;
+        sqesSize_=params.sq_entries*sizeof(io_uring_sqe);
+        sqes_=static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize_, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                                              fd_, IORING_OFF_SQES));
+        if(sqes_==MAP_FAILED) return;
+
+        const auto sq=static_cast<char*>(sqRing_);
+        sqHead_=reinterpret_cast<unsigned*>(sq+params.sq_off.head);
+        sqTail_=reinterpret_cast<unsigned*>(sq+params.sq_off.tail);
+        sqArray_=reinterpret_cast<unsigned*>(sq+params.sq_off.array);
+        sqMask_=*reinterpret_cast<unsigned*>(sq+params.sq_off.ring_mask);
+        sqEntries_=params.sq_entries;
+        const auto cq=static_cast<char*>(cqRing_);
+        cqHead_=reinterpret_cast<unsigned*>(cq+params.cq_off.head);
+        cqTail_=reinterpret_cast<unsigned*>(cq+params.cq_off.tail);
+        cqes_=reinterpret_cast<io_uring_cqe*>(cq+params.cq_off.cqes);
+        cqMask_=*reinterpret_cast<unsigned*>(cq+params.cq_off.ring_mask);
+    }
+    ~Ring()
+    {
+        if(sqes_!=MAP_FAILED) munmap(sqes_, sqesSize_);
+        if(cqRing_!=MAP_FAILED && cqRing_!=sqRing_) munmap(cqRing_, cqRingSize_);
+        if(sqRing_!=MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        if(fd_>=0) close(fd_);
+    }
+    Ring(Ring const&)=delete;
+    Ring& operator=(Ring const&)=delete;
+
+    bool valid() const { return cqes_; }
+    unsigned capacity() const { return sqEntries_; }
+
+    io_uring_sqe& nextSqe(const unsigned char opcode, const int fd, const uint64_t userData)
+    {
+        const auto tail=*sqTail_+pendingSubmissions_;
+        const auto index=tail & sqMask_;
+        auto& sqe=sqes_[index];
+        std::memset(&sqe, 0, sizeof sqe);
+        sqe.opcode=opcode;
+        sqe.fd=fd;
+        sqe.user_data=userData;
+        sqArray_[index]=index;
+        ++pendingSubmissions_;
+        return sqe;
+    }
+
+    enum class Outcome
+    {
+        Done,
+        // Not all the entries have been submitted, but those that have are complete
+        Failed,
+        // Submitted entries may still be in flight, so the memory and the files they use must be left alone
+        Abandoned,
+    };
+
+    // Submits the queued entries and waits for completionCount completions, passing each to handler
+    template<typename Handler>
+    Outcome submitAndWait(const unsigned completionCount, unsigned long& syscallCount, Handler&& handler)
+    {
+        const auto sqHeadBefore=__atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        __atomic_store_n(sqTail_, *sqTail_+pendingSubmissions_, __ATOMIC_RELEASE);
+        unsigned toSubmit=pendingSubmissions_;
+        pendingSubmissions_=0;
+        unsigned completed=0;
+        const auto reap=[&]
+        {
+            auto head=*cqHead_;
+            const auto tail=__atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+            for(; head!=tail; ++head)
+            {
+                const auto& cqe=cqes_[head & cqMask_];
+                handler(cqe.user_data, cqe.res);
+                ++completed;
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        };
+        while(toSubmit || completed<completionCount)
+        {
+            const auto ret=syscall(__NR_io_uring_enter, fd_, toSubmit, completionCount-std::min(completed, completionCount),
+                                   IORING_ENTER_GETEVENTS, nullptr, 0);
+            ++syscallCount;
+            if(ret<0)
+            {
+                if(errno==EINTR || errno==EAGAIN || errno==EBUSY) continue;
+                break;
+            }
+            toSubmit-=std::min<unsigned>(toSubmit, ret);
+            reap();
+        }
+        if(!toSubmit && completed>=completionCount)
+            return Outcome::Done;
+
+        // Take back the entries the kernel hasn't consumed, and wait for those it has.
+        // Without SQPOLL, the kernel only looks at the tail when entered.
+        const auto sqHead=__atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        __atomic_store_n(sqTail_, sqHead, __ATOMIC_RELEASE);
+        const unsigned submitted=sqHead-sqHeadBefore;
+        while(completed<submitted)
+        {
+            const auto ret=syscall(__NR_io_uring_enter, fd_, 0, submitted-completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+            ++syscallCount;
+            if(ret<0 && errno!=EINTR && errno!=EAGAIN && errno!=EBUSY)
+                return Outcome::Abandoned;
+            reap();
+        }
+        return Outcome::Failed;
+    }
+};
+
+Ring* threadRing()
+{
+    // Each enumeration thread gets its own ring, so that no locking is needed
+    thread_local std::unique_ptr<Ring> ring;
+    if(!ring)
+    {
+        ring=std::make_unique<Ring>();
+        if(!ring->valid())
+            ioUringUnusable=true;
+    }
+    return ring->valid() ? ring.get() : nullptr;
+}
+
+}
+
+bool ioUringReadAttributes(std::vector<AttributeRead>& reads, unsigned long& syscallCount)
+{
+    if(ioUringUnusable) return false;
+    const auto ring=threadRing();
+    if(!ring) return false;
+
+    std::vector<int> fds(reads.size(), -1);
+    for(std::size_t chunkBegin=0; chunkBegin<reads.size(); chunkBegin+=ring->capacity())
+    {
+        const auto chunkEnd=std::min<std::size_t>(reads.size(), chunkBegin+ring->capacity());
+        for(auto n=chunkBegin; n<chunkEnd; ++n)
+        {
+            auto& sqe=ring->nextSqe(IORING_OP_OPENAT, reads[n].dirFd, n);
+            sqe.addr=reinterpret_cast<uint64_t>(reads[n].name);
+            sqe.open_flags=O_RDONLY|O_CLOEXEC;
+        }
+        bool unsupported=false;
+        const auto outcome=ring->submitAndWait(chunkEnd-chunkBegin, syscallCount, [&](const uint64_t n, const int res)
+        {
+            if(res>=0)
+                fds[n]=res;
+            else if(res==-EINVAL)
+                unsupported=true; // kernels before 5.6 don't know IORING_OP_OPENAT
+            else
+                reads[n].error=-res;
+        });
+        if(outcome!=Ring::Outcome::Done || unsupported)
+        {
+            // The files opened by abandoned entries are leaked, there's no telling when they arrive
+            for(const auto fd : fds)
+                if(fd>=0) close(fd);
+            ioUringUnusable=true;
+            return false;
+        }
+    }
+
+    std::vector<char> buffers(reads.size()*ATTRIBUTE_BUFFER_SIZE);
+    // Each file takes two entries: a read, and a close linked to it
+    const auto chunkSize=ring->capacity()/2;
+    for(std::size_t chunkBegin=0; chunkBegin<reads.size(); chunkBegin+=chunkSize)
+    {
+        const auto chunkEnd=std::min<std::size_t>(reads.size(), chunkBegin+chunkSize);
+        unsigned submitted=0;
+        for(auto n=chunkBegin; n<chunkEnd; ++n)
+        {
+            if(fds[n]<0) continue;
+            auto& readSqe=ring->nextSqe(IORING_OP_READ, fds[n], n);
+            readSqe.addr=reinterpret_cast<uint64_t>(&buffers[n*ATTRIBUTE_BUFFER_SIZE]);
+            readSqe.len=ATTRIBUTE_BUFFER_SIZE;
+            readSqe.off=0;
+            // A hard link, since a plain one would be broken by the (always) short read
+            readSqe.flags=IOSQE_IO_HARDLINK;
+            // The close completion is tagged with the high bit set
+            ring->nextSqe(IORING_OP_CLOSE, fds[n], n | uint64_t(1)<<63);
+            submitted+=2;
+        }
+        const auto outcome=ring->submitAndWait(submitted, syscallCount, [&](const uint64_t userData, const int res)
+        {
+            const auto n=userData & ~(uint64_t(1)<<63);
+            if(userData>>63)
+            {
+                // Shouldn't happen with a hard link, but if the close didn't run, the file is still ours to close
+                if(res==-ECANCELED)
+                {
+                    close(fds[n]);
+                    ++syscallCount;
+                }
+                fds[n]=-1;
+                return;
+            }
+            if(res<0)
+                reads[n].error=-res;
+            else
+                reads[n].data.assign(&buffers[n*ATTRIBUTE_BUFFER_SIZE], res);
+        });
+        if(outcome!=Ring::Outcome::Done)
+        {
+            ioUringUnusable=true;
+            if(outcome==Ring::Outcome::Abandoned)
+            {
+                // The kernel may still read into the buffers and close the files of this chunk,
+                // whose numbers may have been reused by then. So leak the buffers, and only
+                // close the files of the later chunks, which haven't been submitted.
+                static_cast<void>(new std::vector<char>(std::move(buffers)));
+                for(auto n=chunkEnd; n<reads.size(); ++n)
+                    if(fds[n]>=0) close(fds[n]);
+                return false;
+            }
+            // Those whose close has run are -1 by now
+            for(const auto fd : fds)
+                if(fd>=0) close(fd);
+            return false;
+        }
+    }
+    return true;
+}
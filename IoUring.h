@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct AttributeRead
+{
+    int dirFd;
+    const char* name;
+    int error=0; // errno of a failed open or read
+    std::string data;
+};
+
+// Reads all the files with two io_uring submissions: one opening them, another
+// one reading and closing them. Returns false if io_uring isn't usable, in which
+// case nothing has been read. syscallCount is incremented by the number of syscalls made.
+bool ioUringReadAttributes(std::vector<AttributeRead>& reads, unsigned long& syscallCount);
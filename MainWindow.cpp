@@ -1,12 +1,24 @@
 #include "MainWindow.h"
+#include <set>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <QTimer>
 #include <QScreen>
 #include <QMenuBar>
 #include <QSplitter>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
 #include <QFontMetrics>
 #include <QApplication>
 #include "PropertiesWidget.h"
 #include "DeviceTreeWidget.h"
 #include "DeviceTree.h"
+#include "DeviceTreeReader.h"
+#include "HotplugMonitor.h"
+#include "NameCache.h"
+#include "NameSearchIndex.h"
 
 void MainWindow::createMenuBar()
 {
@@ -16,6 +28,16 @@ void MainWindow::createMenuBar()
     QObject::connect(exitAction, &QAction::triggered, qApp, &QApplication::quit);
     const auto view = menuBar->addMenu(QObject::tr("&View"));
 
+    {
+        const auto action = view->addAction(QObject::tr("&Find..."));
+        action->setShortcuts(QKeySequence::Find);
+        QObject::connect(action, &QAction::triggered, this, [this]
+        {
+            findEdit_->setFocus();
+            findEdit_->selectAll();
+        });
+    }
+
     {
         const auto action = view->addAction(QObject::tr("&Refresh"));
         action->setShortcut(QKeySequence::Refresh);
@@ -52,11 +74,118 @@ void MainWindow::createMenuBar()
 
 void MainWindow::refresh()
 {
-    treeWidget_->setTree(readDeviceTree());
+    reader_->refresh();
+}
+
+void MainWindow::onRootHubRead(std::shared_ptr<const DeviceGraph> const& subtree, const unsigned refreshGeneration)
+{
+    // Later refreshes keep showing the old tree until the new one is complete
+    if(treeWidget_->tree()) return;
+    // The hubs of a cancelled read are read again
+    if(refreshGeneration!=partialRefreshGeneration_)
+    {
+        partialRootHubs_.clear();
+        partialRefreshGeneration_=refreshGeneration;
+    }
+    const auto busOf=[](DeviceGraph const& graph){ return graph[*graph.children(DeviceGraph::NONE).begin()].busNum; };
+    const auto pos=std::upper_bound(partialRootHubs_.begin(), partialRootHubs_.end(), busOf(*subtree),
+                                    [&busOf](const unsigned bus, auto const& hub){ return bus < busOf(*hub); });
+    partialRootHubs_.insert(pos, subtree);
+    treeWidget_->setRootHubs(partialRootHubs_);
+}
+
+void MainWindow::onTreeRead(std::shared_ptr<const DeviceGraph> const& tree)
+{
+    partialRootHubs_.clear();
+    treeWidget_->setTree(tree);
+    // The read may have started before the name databases were loaded, and finished after the names were resolved
+    for(DeviceGraph::Index n=0; n<tree->size(); ++n)
+    {
+        if((*tree)[n].namesPending)
+        {
+            NameCache::instance().whenDatabasesLoaded([this]
+            {
+                QMetaObject::invokeMethod(this, [this]{ reader_->resolvePendingNames(); }, Qt::QueuedConnection);
+            });
+            break;
+        }
+    }
+}
+
+void MainWindow::timeFirstPaint(QElapsedTimer const& startupTimer, const bool quitAfterwards)
+{
+    startupTimer_=startupTimer;
+    quitAfterFirstPaint_=quitAfterwards;
+    treeWidget_->viewport()->installEventFilter(this);
+}
+
+bool MainWindow::eventFilter(QObject*const watched, QEvent*const event)
+{
+    if(event->type()==QEvent::Paint && startupTimer_.isValid())
+    {
+        const auto elapsed=startupTimer_.elapsed();
+        startupTimer_.invalidate();
+        if(quitAfterFirstPaint_)
+        {
+            std::cout << "First paint after " << elapsed << " ms\n";
+            QTimer::singleShot(0, qApp, &QApplication::quit);
+        }
+        else if(std::getenv("USBVIEW_STATS"))
+            std::cerr << "First paint after " << elapsed << " ms\n";
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::onFindTextChanged(QString const& text)
+{
+    treeWidget_->setFindText(text);
+    findResults_->clear();
+    if(text.trimmed().isEmpty())
+    {
+        findResults_->hide();
+        return;
+    }
+    const auto searchIndex=NameCache::instance().searchIndex();
+    if(!searchIndex)
+    {
+        // Search again once the index is there
+        NameCache::instance().whenSearchIndexBuilt([this]
+        {
+            QMetaObject::invokeMethod(this, [this]{ onFindTextChanged(findEdit_->text()); }, Qt::QueuedConnection);
+        });
+        findResults_->hide();
+        return;
+    }
+
+    // Plugged in models are highlighted in the tree instead
+    std::set<uint32_t> present;
+    if(const auto tree=treeWidget_->tree())
+    {
+        for(DeviceGraph::Index n=0; n<tree->size(); ++n)
+            present.insert((*tree)[n].vendorId<<16 | (*tree)[n].productId);
+    }
+    constexpr std::size_t maxResults=500;
+    for(const auto& match : searchIndex->find(text, maxResults))
+    {
+        if(match.isVendor)
+        {
+            findResults_->addItem(QString("%1 %2").arg(match.vendorId, 4, 16, QLatin1Char('0')).arg(match.vendorName));
+        }
+        else if(!present.count(uint32_t(match.vendorId)<<16 | match.productId))
+        {
+            findResults_->addItem(QString("%1:%2 %3 %4").arg(match.vendorId, 4, 16, QLatin1Char('0'))
+                                                         .arg(match.productId, 4, 16, QLatin1Char('0'))
+                                                         .arg(match.vendorName, match.productName));
+        }
+    }
+    findResults_->setVisible(findResults_->count()!=0);
 }
 
 void MainWindow::onTreeUpdated()
 {
+    if(!findEdit_->text().isEmpty())
+        onFindTextChanged(findEdit_->text());
+
     const auto treeWidth=std::min(treeWidget_->sizeHint().width(), width()/2);
     splitter_->setSizes({treeWidth, width()-treeWidth});
 }
@@ -65,9 +194,24 @@ MainWindow::MainWindow()
     : treeWidget_(new DeviceTreeWidget)
     , propsWidget_(new PropertiesWidget)
     , splitter_(new QSplitter)
+    , hotplugMonitor_(new HotplugMonitor(this))
+    , reader_(new DeviceTreeReader([this]{ return treeWidget_->tree(); }, this))
+    , findEdit_(new QLineEdit)
+    , findResults_(new QListWidget)
 {
     setWindowTitle(QObject::tr("USB Device Tree"));
-    splitter_->addWidget(treeWidget_);
+    const auto treePane=new QWidget;
+    {
+        const auto layout=new QVBoxLayout(treePane);
+        layout->setContentsMargins(0,0,0,0);
+        layout->addWidget(findEdit_);
+        layout->addWidget(treeWidget_, 1);
+        layout->addWidget(findResults_);
+        findEdit_->setPlaceholderText(QObject::tr("Find vendor, product or ID"));
+        findEdit_->setClearButtonEnabled(true);
+        findResults_->hide();
+    }
+    splitter_->addWidget(treePane);
     splitter_->addWidget(propsWidget_);
     splitter_->setStretchFactor(1,1);
     splitter_->setStretchFactor(0,0);
@@ -82,8 +226,29 @@ MainWindow::MainWindow()
            std::min(screenAvailableSize.height(), fontHeight*50));
 
     QObject::connect(treeWidget_, &DeviceTreeWidget::deviceSelected, propsWidget_, &PropertiesWidget::showDevice);
-    QObject::connect(treeWidget_, &DeviceTreeWidget::devicesUnselected, propsWidget_, &PropertiesWidget::clear);
+    QObject::connect(treeWidget_, &DeviceTreeWidget::devicesUnselected, propsWidget_, [this]{ propsWidget_->showDevice(nullptr); });
     connect(treeWidget_, &DeviceTreeWidget::treeUpdated, this, &MainWindow::onTreeUpdated);
+    connect(hotplugMonitor_, &HotplugMonitor::devicesChanged, reader_, &DeviceTreeReader::update);
+    connect(reader_, &DeviceTreeReader::rootHubRead, this, &MainWindow::onRootHubRead);
+    connect(reader_, &DeviceTreeReader::treeRead, this, &MainWindow::onTreeRead);
+    connect(findEdit_, &QLineEdit::textChanged, this, &MainWindow::onFindTextChanged);
+
+    // Don't let the first refresh wait for the name databases, fill the names in when they're loaded
+    NameCache::instance().whenDatabasesLoaded([this]
+    {
+        QMetaObject::invokeMethod(this, [this]{ reader_->resolvePendingNames(); }, Qt::QueuedConnection);
+    });
 
     createMenuBar();
 }
+
+MainWindow::~MainWindow()
+{
+    NameCache::instance().whenDatabasesLoaded(nullptr);
+    NameCache::instance().whenSearchIndexBuilt(nullptr);
+}
+
+void MainWindow::setPropertiesCacheCapacity(const unsigned items)
+{
+    propsWidget_->setCacheCapacity(items);
+}
@@ -1,19 +1,45 @@
 #pragma once
 
+#include <memory>
+#include <vector>
 #include <QMainWindow>
+#include <QElapsedTimer>
 
 class DeviceTreeWidget;
 class PropertiesWidget;
+class HotplugMonitor;
+class DeviceTreeReader;
+class DeviceGraph;
 class QSplitter;
+class QLineEdit;
+class QListWidget;
 class MainWindow : public QMainWindow
 {
     DeviceTreeWidget* treeWidget_;
     PropertiesWidget* propsWidget_;
     QSplitter* splitter_;
+    HotplugMonitor* hotplugMonitor_;
+    DeviceTreeReader* reader_;
+    // Root hubs shown while the first tree is being read, sorted by bus
+    std::vector<std::shared_ptr<const DeviceGraph>> partialRootHubs_;
+    unsigned partialRefreshGeneration_=0;
+    QLineEdit* findEdit_;
+    QListWidget* findResults_;
+    QElapsedTimer startupTimer_;
+    bool quitAfterFirstPaint_=false;
 
     void createMenuBar();
     void onTreeUpdated();
     void refresh();
+    void onRootHubRead(std::shared_ptr<const DeviceGraph> const& subtree, unsigned refreshGeneration);
+    void onTreeRead(std::shared_ptr<const DeviceGraph> const& tree);
+    void onFindTextChanged(QString const& text);
+    bool eventFilter(QObject* watched, QEvent* event) override;
 public:
     MainWindow();
+    ~MainWindow();
+    // Reports the time from the start of startupTimer to the first paint of the device tree
+    void timeFirstPaint(QElapsedTimer const& startupTimer, bool quitAfterwards);
+    // How many devices to keep the rendered properties of
+    void setPropertiesCacheCapacity(unsigned items);
 };
@@ -0,0 +1,472 @@
+#include "NameCache.h"
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include <iostream>
+#include <libudev.h>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "usbids.h"
+#include "NameSearchIndex.h"
+
+namespace
+{
+
+constexpr char MAGIC[8]={'U','V','N','A','M','E','S','1'};
+// The files that can affect the names. Those of hwdb are the ones searched by libudev.
+const char*const SOURCE_FILES[]={"/usr/share/usb.ids", "/usr/share/misc/usb.ids",
+                                 "/etc/udev/hwdb.bin", "/usr/lib/udev/hwdb.bin", "/lib/udev/hwdb.bin"};
+constexpr unsigned SOURCE_COUNT=std::size(SOURCE_FILES);
+constexpr unsigned NAMES_PER_ENTRY=4;
+
+struct FileStamp
+{
+    int64_t mtime;
+    int64_t size;
+};
+
+struct Header
+{
+    char magic[8];
+    FileStamp sources[SOURCE_COUNT];
+    uint32_t entryCount;
+    uint32_t stringsSize;
+};
+
+// Entries are sorted by id. Names are UTF-8, referred to by offset and size in the string pool after the entries.
+struct Entry
+{
+    uint32_t id;
+    uint32_t names[NAMES_PER_ENTRY][2];
+};
+
+Header currentHeader()
+{
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+    for(unsigned n=0; n<SOURCE_COUNT; ++n)
+    {
+        const QFileInfo info(SOURCE_FILES[n]);
+        if(info.exists())
+            header.sources[n]={info.lastModified().toMSecsSinceEpoch(), info.size()};
+    }
+    return header;
+}
+
+std::vector<int64_t> sourceStamps()
+{
+    const auto header=currentHeader();
+    std::vector<int64_t> stamps;
+    for(const auto& source : header.sources)
+    {
+        stamps.push_back(source.mtime);
+        stamps.push_back(source.size);
+    }
+    return stamps;
+}
+
+QString cacheFilePath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("names.bin");
+}
+
+class Hwdb
+{
+    udev* udev_;
+    udev_hwdb* hwdb_;
+    // udev_hwdb isn't thread-safe: a query replaces the property list of the previous one
+    std::mutex mutex_;
+public:
+    Hwdb()
+        : udev_(udev_new())
+        , hwdb_(udev_ ? udev_hwdb_new(udev_) : nullptr)
+    {
+    }
+    ~Hwdb()
+    {
+        if(hwdb_) udev_hwdb_unref(hwdb_);
+        if(udev_) udev_unref(udev_);
+    }
+    Hwdb(Hwdb const&)=delete;
+    Hwdb& operator=(Hwdb const&)=delete;
+
+    InternedString get(const char* modalias, const char* key)
+    {
+        if(!hwdb_) return {};
+        std::lock_guard lock(mutex_);
+        udev_list_entry* entry;
+        udev_list_entry_foreach(entry, udev_hwdb_get_properties_list_entry(hwdb_, modalias, 0))
+        {
+            if(!strcmp(udev_list_entry_get_name(entry), key))
+                return InternedString(udev_list_entry_get_value(entry));
+        }
+        return {};
+    }
+};
+
+InternedString* namesArray(DeviceNames& names, const unsigned n)
+{
+    InternedString*const fields[NAMES_PER_ENTRY]={&names.hwdbVendor, &names.hwdbProduct, &names.usbidsVendor, &names.usbidsProduct};
+    return fields[n];
+}
+
+}
+
+struct NameCache::Databases
+{
+    std::unique_ptr<Hwdb> hwdb;
+    std::shared_ptr<const USBIDS> usbids;
+
+    // Most models share their vendor with another one, so the vendor query is done once per vendor
+    std::mutex vendorsMutex;
+    std::unordered_map<unsigned, InternedString> hwdbVendors;
+
+    DeviceNames lookup(unsigned vendorId, unsigned productId);
+};
+
+DeviceNames NameCache::Databases::lookup(const unsigned vendorId, const unsigned productId)
+{
+    DeviceNames names;
+    const auto vendorIdStr=QString("%1").arg(vendorId, 4, 16, QChar('0')).toUpper();
+    const auto productIdStr=QString("%1").arg(productId, 4, 16, QChar('0')).toUpper();
+    {
+        std::unique_lock lock(vendorsMutex);
+        const auto it=hwdbVendors.find(vendorId);
+        if(it!=hwdbVendors.end())
+            names.hwdbVendor=it->second;
+        else
+        {
+            lock.unlock();
+            names.hwdbVendor=hwdb->get(QString("usb:v%1*").arg(vendorIdStr).toStdString().c_str(), "ID_VENDOR_FROM_DATABASE");
+            lock.lock();
+            hwdbVendors.emplace(vendorId, names.hwdbVendor);
+        }
+    }
+    names.hwdbProduct=hwdb->get(QString("usb:v%1p%2").arg(vendorIdStr, productIdStr).toStdString().c_str(), "ID_PRODUCT_FROM_DATABASE");
+    names.usbidsVendor=InternedString::fromQString(usbids->vendor(vendorId));
+    names.usbidsProduct=InternedString::fromQString(usbids->product(vendorId, productId));
+    return names;
+}
+
+NameCache& NameCache::instance()
+{
+    static NameCache cache;
+    return cache;
+}
+
+NameCache::NameCache()
+    : file_(cacheFilePath())
+    , sourceStamps_(sourceStamps())
+{
+    if(!file_.exists() || !file_.open(QFile::ReadOnly))
+        return;
+    const auto size=std::size_t(file_.size());
+    if(size < sizeof(Header))
+        return;
+    const auto data=file_.map(0, size);
+    if(!data)
+        return;
+
+    Header header;
+    std::memcpy(&header, data, sizeof header);
+    const auto expected=currentHeader();
+    if(std::memcmp(header.magic, expected.magic, sizeof header.magic) ||
+       std::memcmp(header.sources, expected.sources, sizeof header.sources) ||
+       sizeof(Header)+std::size_t(header.entryCount)*sizeof(Entry)+header.stringsSize != size)
+    {
+        // Stale or foreign, will be overwritten on save
+        file_.unmap(data);
+        return;
+    }
+    mapped_=data;
+    entryCount_=header.entryCount;
+    entries_=data+sizeof(Header);
+    strings_=entries_+entryCount_*sizeof(Entry);
+    stringsSize_=header.stringsSize;
+}
+
+void NameCache::loadDatabases()
+{
+    auto databases=std::make_shared<Databases>();
+    std::thread usbidsThread([&databases]{ databases->usbids=std::make_shared<const USBIDS>(); });
+    databases->hwdb=std::make_unique<Hwdb>();
+    usbidsThread.join();
+
+    std::lock_guard callbackLock(callbackMutex_);
+    std::function<void()> callback;
+    {
+        std::lock_guard lock(mutex_);
+        databases_=std::move(databases);
+        databaseState_=DatabaseState::Loaded;
+        callback=std::move(onDatabasesLoaded_);
+        onDatabasesLoaded_=nullptr;
+    }
+    databasesLoaded_.notify_all();
+    if(callback)
+        callback();
+}
+
+NameCache::~NameCache()
+{
+    if(warmUpThread_.joinable())
+        warmUpThread_.join();
+    if(searchIndexThread_.joinable())
+        searchIndexThread_.join();
+}
+
+void NameCache::warmUp()
+{
+    std::lock_guard lock(mutex_);
+    if(databaseState_!=DatabaseState::NotLoaded) return;
+    databaseState_=DatabaseState::Loading;
+    // Nothing has loaded the databases to build the index from yet
+    const auto buildIndex=!searchIndexBuilding_;
+    searchIndexBuilding_=true;
+    warmUpThread_=std::thread([this, buildIndex]
+    {
+        loadDatabases();
+        if(buildIndex)
+            buildSearchIndex();
+    });
+}
+
+void NameCache::whenDatabasesLoaded(std::function<void()> callback)
+{
+    std::lock_guard callbackLock(callbackMutex_);
+    {
+        std::lock_guard lock(mutex_);
+        if(databaseState_==DatabaseState::Loading)
+        {
+            onDatabasesLoaded_=std::move(callback);
+            return;
+        }
+    }
+    if(callback)
+        callback();
+}
+
+bool NameCache::findMapped(const uint32_t id, DeviceNames& names) const
+{
+    std::size_t first=0, last=entryCount_.load();
+    while(first<last)
+    {
+        const auto middle=first+(last-first)/2;
+        Entry entry;
+        std::memcpy(&entry, entries_+middle*sizeof(Entry), sizeof entry);
+        if(entry.id<id)
+        {
+            first=middle+1;
+            continue;
+        }
+        if(entry.id>id)
+        {
+            last=middle;
+            continue;
+        }
+        for(unsigned n=0; n<NAMES_PER_ENTRY; ++n)
+        {
+            const auto [offset, size]=entry.names[n];
+            if(std::size_t(offset)+size > stringsSize_)
+                return false;
+            *namesArray(names, n)=InternedString(std::string_view(reinterpret_cast<const char*>(strings_+offset), size));
+        }
+        return true;
+    }
+    return false;
+}
+
+DeviceNames NameCache::lookup(const unsigned vendorId, const unsigned productId)
+{
+    const uint32_t id=vendorId<<16 | productId;
+    DeviceNames names;
+    if(findMapped(id, names))
+    {
+        ++hits_;
+        return names;
+    }
+    std::shared_ptr<Databases> databases;
+    {
+        std::unique_lock lock(mutex_);
+        const auto it=added_.find(id);
+        if(it!=added_.end())
+        {
+            ++hits_;
+            return it->second;
+        }
+        if(databaseState_==DatabaseState::NotLoaded)
+        {
+            databaseState_=DatabaseState::Loading;
+            lock.unlock();
+            loadDatabases();
+            lock.lock();
+        }
+        else if(databaseState_==DatabaseState::Loading)
+        {
+            if(onDatabasesLoaded_)
+            {
+                ++pending_;
+                names.pending=true;
+                return names;
+            }
+            databasesLoaded_.wait(lock, [this]{ return databaseState_!=DatabaseState::Loading; });
+        }
+        databases=databases_;
+    }
+    ++misses_;
+    if(databases)
+        names=databases->lookup(vendorId, productId);
+    std::lock_guard lock(mutex_);
+    // Names from the databases that have just been invalidated aren't worth keeping
+    if(databases && databases==databases_)
+    {
+        added_.emplace(id, names);
+        unsaved_=true;
+    }
+    return names;
+}
+
+bool NameCache::revalidate()
+{
+    auto stamps=sourceStamps();
+    std::lock_guard lock(mutex_);
+    if(stamps==sourceStamps_) return false;
+    sourceStamps_=std::move(stamps);
+    ++invalidations_;
+    // The names handed out already stay valid, the mapping is just not searched anymore
+    entryCount_=0;
+    added_.clear();
+    // Replaces the stale file
+    unsaved_=true;
+    if(databaseState_==DatabaseState::Loaded)
+    {
+        databases_.reset();
+        databaseState_=DatabaseState::NotLoaded;
+    }
+    searchIndex_.reset();
+    return true;
+}
+
+void NameCache::buildSearchIndex()
+{
+    std::shared_ptr<Databases> databases;
+    {
+        std::unique_lock lock(mutex_);
+        if(databaseState_==DatabaseState::NotLoaded)
+        {
+            databaseState_=DatabaseState::Loading;
+            lock.unlock();
+            loadDatabases();
+            lock.lock();
+        }
+        databasesLoaded_.wait(lock, [this]{ return databaseState_!=DatabaseState::Loading; });
+        databases=databases_;
+    }
+    // Shares usb.ids with the lookups instead of parsing another copy
+    std::shared_ptr<const NameSearchIndex> index;
+    if(databases)
+        index=std::make_shared<const NameSearchIndex>(databases->usbids);
+
+    std::lock_guard callbackLock(callbackMutex_);
+    std::function<void()> callback;
+    {
+        std::lock_guard lock(mutex_);
+        searchIndexBuilding_=false;
+        // An index of databases that have just been invalidated isn't worth keeping
+        if(databases && databases==databases_)
+            searchIndex_=std::move(index);
+        callback=std::move(onSearchIndexBuilt_);
+        onSearchIndexBuilt_=nullptr;
+    }
+    if(callback)
+        callback();
+}
+
+std::shared_ptr<const NameSearchIndex> NameCache::searchIndex()
+{
+    std::thread finished;
+    {
+        std::lock_guard lock(mutex_);
+        if(searchIndex_ || searchIndexBuilding_)
+            return searchIndex_;
+        searchIndexBuilding_=true;
+        finished=std::move(searchIndexThread_);
+        searchIndexThread_=std::thread([this]{ buildSearchIndex(); });
+    }
+    // It has cleared searchIndexBuilding_ already, so it's about to end
+    if(finished.joinable())
+        finished.join();
+    return nullptr;
+}
+
+void NameCache::whenSearchIndexBuilt(std::function<void()> callback)
+{
+    std::lock_guard callbackLock(callbackMutex_);
+    {
+        std::lock_guard lock(mutex_);
+        if(searchIndexBuilding_)
+        {
+            onSearchIndexBuilt_=std::move(callback);
+            return;
+        }
+    }
+    if(callback)
+        callback();
+}
+
+NameCacheStats NameCache::stats() const
+{
+    return {hits_.load(), misses_.load(), pending_.load(), invalidations_.load()};
+}
+
+void NameCache::save()
+{
+    std::lock_guard lock(mutex_);
+    if(!unsaved_) return;
+    unsaved_=false;
+
+    auto all=added_;
+    for(std::size_t n=0; n<entryCount_; ++n)
+    {
+        uint32_t id;
+        std::memcpy(&id, entries_+n*sizeof(Entry), sizeof id);
+        DeviceNames names;
+        if(findMapped(id, names))
+            all.emplace(id, names);
+    }
+
+    auto header=currentHeader();
+    header.entryCount=all.size();
+    QByteArray entries, strings;
+    for(auto& [id, names] : all)
+    {
+        Entry entry{};
+        entry.id=id;
+        for(unsigned n=0; n<NAMES_PER_ENTRY; ++n)
+        {
+            const auto utf8=namesArray(names, n)->view();
+            entry.names[n][0]=strings.size();
+            entry.names[n][1]=utf8.size();
+            strings.append(utf8.data(), utf8.size());
+        }
+        entries.append(reinterpret_cast<const char*>(&entry), sizeof entry);
+    }
+    header.stringsSize=strings.size();
+
+    const auto path=cacheFilePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile out(path);
+    if(!out.open(QFile::WriteOnly) ||
+       out.write(reinterpret_cast<const char*>(&header), sizeof header)!=sizeof header ||
+       out.write(entries)!=entries.size() ||
+       out.write(strings)!=strings.size() ||
+       !out.commit())
+    {
+        std::cerr << "Warning: failed to write name cache \"" << path.toStdString() << "\": "
+                  << out.errorString().toStdString() << "\n";
+        return;
+    }
+    // The mapping of the old file stays valid, so only the new entries are kept in memory
+}
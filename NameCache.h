@@ -0,0 +1,115 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+#include <QFile>
+#include <QString>
+#include "InternedString.h"
+
+class NameSearchIndex;
+
+struct DeviceNames
+{
+    InternedString hwdbVendor;
+    InternedString hwdbProduct;
+    InternedString usbidsVendor;
+    InternedString usbidsProduct;
+    // Not looked up yet because the databases are still being loaded
+    bool pending=false;
+};
+
+struct NameCacheStats
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long pending;
+    unsigned long invalidations;
+};
+
+// Names of device models from hwdb and usb.ids, persisted in the user's cache
+// directory and memory-mapped on startup. The databases themselves are only
+// loaded when a model isn't in the cache. The cache file is ignored if any of
+// the databases has changed since it was written.
+class NameCache
+{
+    struct Databases;
+
+    QFile file_;
+    const uchar* mapped_=nullptr;
+    std::atomic<std::size_t> entryCount_{0};
+    const uchar* entries_=nullptr;
+    const uchar* strings_=nullptr;
+    std::size_t stringsSize_=0;
+
+    std::mutex mutex_;
+    std::map<uint32_t, DeviceNames> added_;
+    bool unsaved_=false;
+    // Modification times and sizes of the database files when they were last checked
+    std::vector<int64_t> sourceStamps_;
+
+    enum class DatabaseState
+    {
+        NotLoaded,
+        Loading,
+        Loaded,
+    };
+    DatabaseState databaseState_=DatabaseState::NotLoaded;
+    std::shared_ptr<Databases> databases_;
+    std::condition_variable databasesLoaded_;
+    std::function<void()> onDatabasesLoaded_;
+    // Held while the callback is called, so that it can't be called anymore once replaced. Taken before mutex_.
+    std::mutex callbackMutex_;
+    std::thread warmUpThread_;
+    // Built from the usb.ids of the loaded databases, and dropped with them
+    std::shared_ptr<const NameSearchIndex> searchIndex_;
+    bool searchIndexBuilding_=false;
+    std::function<void()> onSearchIndexBuilt_;
+    std::thread searchIndexThread_;
+
+    std::atomic<unsigned long> hits_{0};
+    std::atomic<unsigned long> misses_{0};
+    std::atomic<unsigned long> pending_{0};
+    std::atomic<unsigned long> invalidations_{0};
+
+    NameCache();
+    ~NameCache();
+    bool findMapped(uint32_t id, DeviceNames& names) const;
+    // Called with databaseState_ set to Loading
+    void loadDatabases();
+    // Called with searchIndexBuilding_ set, loads the databases if needed
+    void buildSearchIndex();
+public:
+    static NameCache& instance();
+    // Starts loading hwdb and usb.ids on worker threads, so that the first
+    // lookup doesn't have to, and then builds the search index. Lookups made
+    // meanwhile wait for the databases.
+    void warmUp();
+    // Lets the lookups made while warming up return pending names instead of
+    // waiting. The callback is called from a worker thread once the databases
+    // are loaded, or right away if they aren't being loaded. Once this returns,
+    // the previous callback isn't running and won't be called.
+    void whenDatabasesLoaded(std::function<void()> callback);
+    // Thread-safe
+    DeviceNames lookup(unsigned vendorId, unsigned productId);
+    // Forgets all the names and the search index if any of the databases has
+    // changed on disk since they were looked up, and returns whether it has.
+    // Lookups running meanwhile may still return the old names.
+    bool revalidate();
+    // Returns null while the index is being built on a worker thread, which
+    // this starts if it isn't built yet
+    std::shared_ptr<const NameSearchIndex> searchIndex();
+    // The callback is called from a worker thread once the search index being
+    // built is done, or right away if none is being built. Once this returns,
+    // the previous callback isn't running and won't be called.
+    void whenSearchIndexBuilt(std::function<void()> callback);
+    NameCacheStats stats() const;
+    // Writes the file if new models have been looked up
+    void save();
+};
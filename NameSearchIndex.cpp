@@ -0,0 +1,121 @@
+#include "NameSearchIndex.h"
+#include <algorithm>
+
+namespace
+{
+
+// Only ASCII is folded, both in the names and in the queries, which keeps it byte-wise
+char toLowerAscii(const char c)
+{
+    return 'A' <= c && c <= 'Z' ? c-'A'+'a' : c;
+}
+
+std::string toLowerAscii(std::string_view str)
+{
+    std::string lower(str);
+    for(auto& c : lower)
+        c=toLowerAscii(c);
+    return lower;
+}
+
+uint32_t trigram(const char* chars)
+{
+    return uint32_t(uint8_t(chars[0]))<<16 | uint32_t(uint8_t(chars[1]))<<8 | uint8_t(chars[2]);
+}
+
+}
+
+NameSearchIndex::NameSearchIndex(std::shared_ptr<const USBIDS> usbids)
+    : usbids_(std::move(usbids))
+{
+    std::unordered_map<uint16_t, std::string_view> vendorNames;
+    usbids_->forEachVendor([&](const uint16_t vendorId, std::string_view name)
+    {
+        vendorNames.emplace(vendorId, name);
+        addEntry(vendorId, 0, true, name, {});
+    });
+    usbids_->forEachProduct([&](const uint16_t vendorId, const uint16_t productId, std::string_view name)
+    {
+        const auto vendor=vendorNames.find(vendorId);
+        addEntry(vendorId, productId, false, vendor==vendorNames.end() ? std::string_view() : vendor->second, name);
+    });
+}
+
+void NameSearchIndex::addEntry(const uint16_t vendorId, const uint16_t productId, const bool isVendor,
+                               std::string_view vendor, std::string_view product)
+{
+    const uint32_t index=entries_.size();
+    const uint32_t offset=text_.size();
+    text_ += toLowerAscii(vendor);
+    if(!isVendor)
+    {
+        text_ += ' ';
+        text_ += toLowerAscii(product);
+    }
+    const Entry entry{vendorId, productId, isVendor, offset, uint32_t(text_.size()-offset)};
+    entries_.push_back(entry);
+
+    const auto text=textOf(entry);
+    for(std::size_t i=0; i+3<=text.size(); ++i)
+    {
+        auto& entries=postings_[trigram(text.data()+i)];
+        if(entries.empty() || entries.back()!=index)
+            entries.push_back(index);
+    }
+}
+
+std::vector<NameSearchIndex::Match> NameSearchIndex::find(QString const& query, const std::size_t maxResults) const
+{
+    const auto needle=toLowerAscii(query.trimmed().toStdString());
+    if(needle.empty()) return {};
+
+    const auto makeMatch=[this](Entry const& entry)
+    {
+        return Match{entry.vendorId, entry.productId, entry.isVendor, usbids_->vendor(entry.vendorId),
+                     entry.isVendor ? QString() : usbids_->product(entry.vendorId, entry.productId)};
+    };
+
+    std::vector<Match> matches;
+    if(needle.size() < 3)
+    {
+        // Too short for trigrams, but then there isn't much to compare either
+        for(const auto& entry : entries_)
+        {
+            if(textOf(entry).find(needle)==std::string_view::npos) continue;
+            matches.push_back(makeMatch(entry));
+            if(matches.size()==maxResults) break;
+        }
+        return matches;
+    }
+
+    std::vector<std::vector<uint32_t> const*> lists;
+    for(std::size_t i=0; i+3<=needle.size(); ++i)
+    {
+        const auto it=postings_.find(trigram(needle.data()+i));
+        if(it==postings_.end())
+            return {};
+        lists.push_back(&it->second);
+    }
+    // Intersecting from the shortest list keeps the candidates few from the start
+    std::sort(lists.begin(), lists.end(), [](auto a, auto b)
+              { return a->size()!=b->size() ? a->size() < b->size() : std::less<>()(a, b); });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+    auto candidates=*lists.front();
+    for(std::size_t n=1; n<lists.size() && !candidates.empty(); ++n)
+    {
+        std::vector<uint32_t> common;
+        std::set_intersection(candidates.begin(), candidates.end(), lists[n]->begin(), lists[n]->end(),
+                              std::back_inserter(common));
+        candidates=std::move(common);
+    }
+
+    // Having all the trigrams doesn't mean having them in a row
+    for(const auto index : candidates)
+    {
+        const auto& entry=entries_[index];
+        if(textOf(entry).find(needle)==std::string_view::npos) continue;
+        matches.push_back(makeMatch(entry));
+        if(matches.size()==maxResults) break;
+    }
+    return matches;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <QString>
+#include "usbids.h"
+
+// Case-insensitive substring search over the vendor and product names in
+// usb.ids. Names are split into trigrams, so a query only has to check the
+// names that contain all the trigrams of the query.
+class NameSearchIndex
+{
+public:
+    struct Match
+    {
+        uint16_t vendorId;
+        uint16_t productId;
+        bool isVendor;
+        QString vendorName;
+        QString productName; // empty for a vendor
+    };
+
+    explicit NameSearchIndex(std::shared_ptr<const USBIDS> usbids);
+    // Products match by "<vendor> <product>", so a vendor name finds all of its products
+    std::vector<Match> find(QString const& query, std::size_t maxResults) const;
+
+private:
+    struct Entry
+    {
+        uint16_t vendorId;
+        uint16_t productId;
+        bool isVendor;
+        uint32_t offset; // of the lowercase text in text_
+        uint32_t size;
+    };
+
+    std::shared_ptr<const USBIDS> usbids_;
+    std::vector<Entry> entries_;
+    std::string text_;
+    // Sorted indices of the entries whose text has the trigram
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;
+
+    void addEntry(uint16_t vendorId, uint16_t productId, bool isVendor, std::string_view vendor, std::string_view product);
+    std::string_view textOf(Entry const& entry) const { return {text_.data()+entry.offset, entry.size}; }
+};
@@ -1,11 +1,14 @@
 #include "PropertiesWidget.h"
+#include <tuple>
 #include <iostream>
 #include <QProcess>
 #include <QFontDatabase>
+#include <QRunnable>
+#include <QThreadPool>
 #include "Device.h"
+#include "DeviceSchema.hpp"
 #include "ExtDescription.h"
 #include "common.hpp"
-#include "HIDReportDescriptor.h"
 
 namespace
 {
@@ -58,18 +61,6 @@ QString name(const DescriptorType type)
     return typeNameIt->second;
 }
 
-QString formatBytes(std::vector<uint8_t> const& data, const bool wrap)
-{
-    QString str;
-    for(unsigned i=0; i<data.size(); ++i)
-	{
-        str += QString("%1 ").arg(+data[i], 2, 16, QChar('0'));
-		if(wrap && (i+1)%16 == 0)
-			str += '\n';
-	}
-    return str.trimmed();
-}
-
 void setFirstColumnSpannedForAllSingleColumnItems(QTreeWidgetItem* item)
 {
     if(item->columnCount()==1)
@@ -99,211 +90,409 @@ QFont getMonospaceFont(QFont const& base)
     return font;
 }
 
+void addHIDDescriptorRows(QTreeWidgetItem*const parent, HIDDescriptorRows const& rows, QFont const& boldFont)
+{
+    for(const auto& row : rows)
+    {
+        const auto item=new QTreeWidgetItem{QStringList{row.text}};
+        if(!row.value.isEmpty())
+            item->setData(1, Qt::DisplayRole, row.value);
+        if(row.boldValue)
+            item->setData(1, Qt::FontRole, boldFont);
+        parent->addChild(item);
+        addHIDDescriptorRows(item, row.children, boldFont);
+    }
+}
+
+// Owned by the thread pool
+class BuildTask : public QRunnable
+{
+    std::function<void()> func_;
+public:
+    explicit BuildTask(std::function<void()> func) : func_(std::move(func)) {}
+    void run() override { func_(); }
+};
+
 }
 
 PropertiesWidget::PropertiesWidget(QWidget* parent)
     : QTreeWidget(parent)
 {
     setHeaderLabels({"Property", "Value"});
+    connect(this, &QTreeWidget::itemExpanded, this, &PropertiesWidget::onItemExpanded);
+}
+
+bool PropertiesWidget::DocumentKey::operator<(DocumentKey const& other) const
+{
+    return std::tie(address, wrapRawDumps, extToolOutput) < std::tie(other.address, other.wrapRawDumps, other.extToolOutput);
+}
+
+PropertiesWidget::Document::~Document()
+{
+    for(const auto item : items)
+        delete item;
 }
 
 void PropertiesWidget::showDevice(Device const* dev)
 {
     device_=dev;
-    updateTree();
+    if(!dev)
+    {
+        stashCurrentDocument();
+        return;
+    }
+    const DocumentKey key{dev->uniqueAddress, wantWrapRawDumps_, wantExtToolOutput_};
+    // A refreshed tree has new Device objects even if nothing about the device has changed
+    if(current_ && !(current_->key<key) && !(key<current_->key) && current_->snapshotId==dev->snapshotId)
+        return;
+
+    stashCurrentDocument();
+    if(auto doc=takeCachedDocument(key); doc && doc->snapshotId==dev->snapshotId)
+        restoreDocument(std::move(doc));
+    else
+        buildDocument(key);
 }
 
-void PropertiesWidget::updateTree()
+void PropertiesWidget::stashCurrentDocument()
 {
-    clear();
-    if(!device_) return;
+    if(!current_) return;
+    const auto doc=std::move(current_);
+    if(!cacheCapacity_)
+    {
+        clear();
+        return;
+    }
 
-    const auto monoFont=getMonospaceFont(font());
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"SYSFS path", device_->sysfsPath}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Device path", device_->devicePath}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Vendor Id", QString("0x%1").arg(device_->vendorId, 4, 16, QLatin1Char('0'))}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Product Id", QString("0x%1").arg(device_->productId, 4, 16, QLatin1Char('0'))}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Revision", device_->revision}});
-    if(!device_->manufacturer.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Manufacturer", device_->manufacturer}});
-    if(!device_->product.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Product", device_->product}});
-    if(!device_->hwdbVendorName.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Vendor name from HW DB", device_->hwdbVendorName}});
-    if(!device_->hwdbProductName.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Product name from HW DB", device_->hwdbProductName}});
-    if(!device_->usbidsVendorName.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Vendor name from usb.ids", device_->usbidsVendorName}});
-    if(!device_->usbidsProductName.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Product name from usb.ids", device_->usbidsProductName}});
-    if(!device_->serialNum.isNull())
-        addTopLevelItem(new QTreeWidgetItem{QStringList{"Serial number", device_->serialNum}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Bus", QString::number(device_->busNum)}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Address", QString::number(device_->devNum)}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"Port", QString::number(device_->port)}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{"USB version", device_->usbVersion}});
+    // Expansion is a property of the view, so it's lost when the items are taken out of it
+    const std::function<void(QTreeWidgetItem*, bool)> collect=[&](QTreeWidgetItem*const item, const bool parentExpanded)
     {
-        QString speed;
-        const auto speedX10=device_->speed*10;
-        switch(int(speedX10))
+        ++doc->itemCount;
+        const bool expanded=parentExpanded && item->isExpanded();
+        if(expanded)
+            doc->expandedItems.push_back(item);
+        for(int i=0; i<item->childCount(); ++i)
+            collect(item->child(i), expanded);
+    };
+    for(int i=0; i<topLevelItemCount(); ++i)
+        collect(topLevelItem(i), true);
+    for(const auto item : invisibleRootItem()->takeChildren())
+        doc->items.push_back(item);
+
+    cachedDocuments_.push_front(doc);
+    cachedDocumentIndex_[doc->key]=cachedDocuments_.begin();
+    cachedItemCount_+=doc->itemCount;
+    evictDocuments();
+}
+
+std::shared_ptr<PropertiesWidget::Document> PropertiesWidget::takeCachedDocument(DocumentKey const& key)
+{
+    const auto it=cachedDocumentIndex_.find(key);
+    if(it==cachedDocumentIndex_.end()) return nullptr;
+    auto doc=std::move(*it->second);
+    cachedDocuments_.erase(it->second);
+    cachedDocumentIndex_.erase(it);
+    cachedItemCount_-=doc->itemCount;
+    doc->itemCount=0;
+    return doc;
+}
+
+void PropertiesWidget::evictDocuments()
+{
+    while(cachedItemCount_ > cacheCapacity_)
+    {
+        cachedItemCount_-=cachedDocuments_.back()->itemCount;
+        cachedDocumentIndex_.erase(cachedDocuments_.back()->key);
+        cachedDocuments_.pop_back();
+    }
+}
+
+void PropertiesWidget::restoreDocument(std::shared_ptr<Document> doc)
+{
+    current_=std::move(doc);
+    QList<QTreeWidgetItem*> items;
+    for(const auto item : current_->items)
+        items.append(item);
+    current_->items.clear();
+    addTopLevelItems(items);
+    for(const auto item : items)
+    {
+        if(item->columnCount()==1)
+            item->setFirstColumnSpanned(true);
+    }
+    // Deeper rows get their spanning back in onItemExpanded
+    for(const auto item : current_->expandedItems)
+        item->setExpanded(true);
+    current_->expandedItems.clear();
+    resizeColumnToContents(0);
+}
+
+void PropertiesWidget::setCacheCapacity(const unsigned items)
+{
+    cacheCapacity_=items;
+    evictDocuments();
+}
+
+void PropertiesWidget::setLazyChildren(QTreeWidgetItem*const item, ChildrenBuilder build)
+{
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    current_->lazyChildren[item]={std::move(build), {}};
+}
+
+void PropertiesWidget::setBackgroundChildren(QTreeWidgetItem*const item, ItemDataBuilder build)
+{
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    current_->lazyChildren[item]={{}, std::move(build)};
+}
+
+void PropertiesWidget::onItemExpanded(QTreeWidgetItem*const item)
+{
+    if(!current_) return;
+    const auto it=current_->lazyChildren.find(item);
+    if(it==current_->lazyChildren.end())
+    {
+        // Spanning is a property of the view too, see restoreDocument
+        for(int i=0; i<item->childCount(); ++i)
         {
-        case 15:     speed=tr(u8"1.5\u202fMb/s (low)");   break;
-        case 120:    speed=tr(u8"12\u202fMb/s (full)");   break;
-        case 4800:   speed=tr(u8"480\u202fMb/s (high)");  break;
-        case 50000:  speed=tr(u8"5\u202fGb/s (super)");   break;
-        case 100000: speed=tr(u8"10\u202fGb/s (super+)"); break;
+            if(item->child(i)->columnCount()==1)
+                item->child(i)->setFirstColumnSpanned(true);
         }
-        if(speedX10!=int(speedX10) || speed.isNull())
+        return;
+    }
+    const auto lazy=std::move(it->second);
+    current_->lazyChildren.erase(it);
+
+    if(lazy.build)
+    {
+        // Right in the tree, so that the builder can expand the new items
+        lazy.build(item);
+        item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+        setFirstColumnSpannedForAllSingleColumnItems(item);
+        return;
+    }
+
+    const auto loadingItem=new QTreeWidgetItem{QStringList{tr("Loading...")}};
+    item->addChild(loadingItem);
+    loadingItem->setFirstColumnSpanned(true);
+    QThreadPool::globalInstance()->start(new BuildTask(
+        [this, doc=std::weak_ptr<Document>(current_), item, build=lazy.buildInBackground]
         {
-            if(device_->speed<1000)
-                speed=tr(u8"%1\u202fMb/s").arg(device_->speed);
-            else
-                speed=tr(u8"%1\u202fGb/s").arg(device_->speed/1000);
-        }
-        addTopLevelItem(new QTreeWidgetItem{QStringList{tr("Speed"), speed}});
+            const auto children=std::make_shared<const std::vector<ItemData>>(build());
+            QMetaObject::invokeMethod(qApp, [this, doc, item, children]
+                                      {
+                                          // The item and the widget live as long as the document, which may be cached by now
+                                          if(doc.lock())
+                                              adoptChildren(item, *children);
+                                      }, Qt::QueuedConnection);
+        }));
+}
+
+void PropertiesWidget::adoptChildren(QTreeWidgetItem*const item, std::vector<ItemData> const& children)
+{
+    const auto monoFont=getMonospaceFont(font());
+    auto boldFont=font();
+    boldFont.setBold(true);
+
+    QList<QTreeWidgetItem*> items;
+    for(const auto& data : children)
+    {
+        const auto child=new QTreeWidgetItem{data.columns};
+        if(data.monospaceColumn>=0)
+            child->setFont(data.monospaceColumn, monoFont);
+        if(data.hidRows)
+            addHIDDescriptorRows(child, *data.hidRows, boldFont);
+        items.append(child);
     }
-    addTopLevelItem(new QTreeWidgetItem{QStringList{tr("Device class"), QString("0x%1 (%2)").arg(device_->devClass, 2, 16, QLatin1Char('0'))
-                                                                                      .arg(device_->devClassStr)}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{tr("Device subclass"), QString("0x%1").arg(device_->devSubClass, 2, 16, QLatin1Char('0'))}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{tr("Device protocol"), QString("0x%1").arg(device_->devProtocol, 2, 16, QLatin1Char('0'))}});
-    addTopLevelItem(new QTreeWidgetItem{QStringList{tr("Max default endpoint packet size"), QString::number(device_->maxPacketSize)}});
-    const auto configsItem=new QTreeWidgetItem{QStringList{tr("Configurations")}};
-    addTopLevelItem(configsItem);
-    configsItem->setExpanded(true);
-    for(const auto& config : device_->configs)
+    qDeleteAll(item->takeChildren());
+    item->addChildren(items);
+    item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+    // Does nothing if the item isn't in the view now
+    setFirstColumnSpannedForAllSingleColumnItems(item);
+}
+
+void PropertiesWidget::addConfigProperties(QTreeWidgetItem*const configItem, DeviceInfo const& dev,
+                                           DeviceInfo::Config const& config)
+{
+    const bool active=dev.isActive(config);
+    const auto attribItem=new QTreeWidgetItem{QStringList{tr("Attributes"),
+                                                          QString("0x%1").arg(config.attributes, 2, 16, QLatin1Char('0'))}};
+    configItem->addChild(attribItem);
     {
-        const auto configItem=new QTreeWidgetItem{QStringList{tr("Configuration %1").arg(config.configNum)}};
-        configsItem->addChild(configItem);
-        configItem->setExpanded(true);
-        const auto attribItem=new QTreeWidgetItem{QStringList{tr("Attributes"),
-                                                              QString("0x%1").arg(config.attributes, 2, 16, QLatin1Char('0'))}};
-        configItem->addChild(attribItem);
+        const auto poweringItem=new QTreeWidgetItem{QStringList{config.attributes&1<<6 ? tr("Self-powered") : tr("Bus-powered")}};
+        attribItem->addChild(poweringItem);
+        const auto remoteWakeupItem=new QTreeWidgetItem{QStringList{config.attributes&1<<5 ? tr("Supports remote wakeup") :
+                                                                                             tr("No remote wakeup support")}};
+        attribItem->addChild(remoteWakeupItem);
+    }
+    configItem->addChild(new QTreeWidgetItem{QStringList{tr("Max power needed"),
+                                             QString(tr(u8"%1\u202fmA")).arg(config.maxPowerMilliAmp)}});
+    const auto ifacesItem=new QTreeWidgetItem{QStringList{tr("Interfaces")}};
+    configItem->addChild(ifacesItem);
+    ifacesItem->setExpanded(true);
+    for(const auto& iface : config.interfaces)
+    {
+        const auto ifaceItem=new QTreeWidgetItem{QStringList{iface.altSettingNum==0 ? tr("Interface %1").arg(iface.ifaceNum)
+                                                             : tr("Interface %1, alternate setting %2").arg(iface.ifaceNum)
+                                                                                                       .arg(iface.altSettingNum)}};
+        ifacesItem->addChild(ifaceItem);
+        ifaceItem->setExpanded(active);
+        const auto binding=dev.binding(config, iface);
+        if(active)
         {
-            const auto poweringItem=new QTreeWidgetItem{QStringList{config.attributes&1<<6 ? tr("Self-powered") : tr("Bus-powered")}};
-            attribItem->addChild(poweringItem);
-            const auto remoteWakeupItem=new QTreeWidgetItem{QStringList{config.attributes&1<<5 ? tr("Supports remote wakeup") :
-                                                                                                 tr("No remote wakeup support")}};
-            attribItem->addChild(remoteWakeupItem);
+            const bool activeAltSetting=binding && binding->altSettingNum==iface.altSettingNum;
+            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Active alternate setting"), activeAltSetting ? tr("yes") : tr("no")}});
         }
-        configItem->addChild(new QTreeWidgetItem{QStringList{tr("Max power needed"),
-                                                 QString(tr(u8"%1\u202fmA")).arg(config.maxPowerMilliAmp)}});
-        const auto ifacesItem=new QTreeWidgetItem{QStringList{tr("Interfaces")}};
-        configItem->addChild(ifacesItem);
-        ifacesItem->setExpanded(true);
-        for(const auto& iface : config.interfaces)
+        if(binding)
+            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("SYSFS path"), binding->sysfsPath}});
+        if(binding && !binding->deviceNodes.empty())
         {
-            const auto ifaceItem=new QTreeWidgetItem{QStringList{tr("Interface %1").arg(iface.ifaceNum)}};
-            ifacesItem->addChild(ifaceItem);
-            ifaceItem->setExpanded(true);
-//            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Active alternate setting"), iface.activeAltSetting ? tr("yes") : tr("no")}});
-            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("SYSFS path"), iface.sysfsPath}});
-            if(!iface.deviceNodes.empty())
-            {
-                const auto devNodesItem=new QTreeWidgetItem{QStringList{tr("Device nodes")}};
-                ifaceItem->addChild(devNodesItem);
-                for(const auto& node : iface.deviceNodes)
-                    devNodesItem->addChild(new QTreeWidgetItem{{node}});
-            }
-            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Alternate setting number"), QString::number(iface.altSettingNum)}});
-            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Class"), QString("0x%1 (%2)")
-                                        .arg(iface.ifaceClass, 2, 16, QLatin1Char('0')).arg(iface.ifaceClassStr)}});
-            QString subclassStr, protocolStr;
-            constexpr unsigned classHID=0x03;
-            if(iface.ifaceClass==classHID)
-            {
-                if(iface.ifaceSubClass==1)
-                    subclassStr=tr("0x%1 (boot interface)").arg(iface.ifaceSubClass, 2, 16, QLatin1Char('0'));
-                if(iface.protocol==1)
-                    protocolStr=QString("0x%1 (keyboard)").arg(iface.protocol, 2, 16, QLatin1Char('0'));
-                else if(iface.protocol==2)
-                    protocolStr=QString("0x%1 (mouse)").arg(iface.protocol, 2, 16, QLatin1Char('0'));
-            }
-            if(subclassStr.isNull())
-                subclassStr=QString("0x%1").arg(iface.ifaceSubClass, 2, 16, QLatin1Char('0'));
-            if(protocolStr.isNull())
-                protocolStr=QString("0x%1").arg(iface.protocol, 2, 16, QLatin1Char('0'));
-            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Subclass"), subclassStr}});
-            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Protocol"), protocolStr}});
-            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Driver"),
-                                                    QString("%1").arg(iface.driver)}});
-            if(iface.ifaceClass==CLASS_HID)
-            {
-                const auto hidReportDescriptorsItem=new QTreeWidgetItem{QStringList{tr("HID report descriptors")}};
-                ifaceItem->addChild(hidReportDescriptorsItem);
-                for(const auto& desc : iface.hidReportDescriptors)
-                {
-                    const auto descItem=new QTreeWidgetItem{QStringList{formatBytes(desc, wantWrapRawDumps_)}};
-                    if(wantWrapRawDumps_)
-                        descItem->setFont(0, monoFont);
-                    hidReportDescriptorsItem->addChild(descItem);
-                    parseHIDReportDescriptor(descItem, font(), desc);
-                }
-
-            }
-            if(iface.numEPs!=0 || !iface.endpoints.empty())
+            const auto devNodesItem=new QTreeWidgetItem{QStringList{tr("Device nodes")}};
+            ifaceItem->addChild(devNodesItem);
+            for(const auto& node : binding->deviceNodes)
+                devNodesItem->addChild(new QTreeWidgetItem{{node}});
+        }
+        ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Alternate setting number"), QString::number(iface.altSettingNum)}});
+        ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Class"), formatInterfaceClass(iface)}});
+        QString subclassStr, protocolStr;
+        constexpr unsigned classHID=0x03;
+        if(iface.ifaceClass==classHID)
+        {
+            if(iface.ifaceSubClass==1)
+                subclassStr=tr("0x%1 (boot interface)").arg(iface.ifaceSubClass, 2, 16, QLatin1Char('0'));
+            if(iface.protocol==1)
+                protocolStr=QString("0x%1 (keyboard)").arg(iface.protocol, 2, 16, QLatin1Char('0'));
+            else if(iface.protocol==2)
+                protocolStr=QString("0x%1 (mouse)").arg(iface.protocol, 2, 16, QLatin1Char('0'));
+        }
+        if(subclassStr.isNull())
+            subclassStr=QString("0x%1").arg(iface.ifaceSubClass, 2, 16, QLatin1Char('0'));
+        if(protocolStr.isNull())
+            protocolStr=QString("0x%1").arg(iface.protocol, 2, 16, QLatin1Char('0'));
+        ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Subclass"), subclassStr}});
+        ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Protocol"), protocolStr}});
+        if(binding)
+        {
+            ifaceItem->addChild(new QTreeWidgetItem{QStringList{tr("Driver"), binding->driver.toQString()}});
+        }
+        if(iface.ifaceClass==CLASS_HID && binding)
+        {
+            const auto hidReportDescriptorsItem=new QTreeWidgetItem{QStringList{tr("HID report descriptors")}};
+            ifaceItem->addChild(hidReportDescriptorsItem);
+            setBackgroundChildren(hidReportDescriptorsItem,
+                                  [descs=binding->hidReportDescriptors, wrap=wantWrapRawDumps_]
+                                  {
+                                      std::vector<ItemData> items;
+                                      for(const auto& desc : descs)
+                                      {
+                                          items.push_back({QStringList{formatBytes(*desc, wrap)}, wrap ? 0 : -1,
+                                                           parseHIDReportDescriptor(desc)});
+                                      }
+                                      return items;
+                                  });
+        }
+        if(iface.numEPs!=0 || !iface.endpoints.empty())
+        {
+            const auto endpointsItem=new QTreeWidgetItem{QStringList{
+                                        iface.endpoints.empty() ? tr("Endpoints (%1)").arg(iface.numEPs) : tr("Endpoints")}};
+            ifaceItem->addChild(endpointsItem);
+            endpointsItem->setExpanded(true);
+            for(const auto& ep : iface.endpoints)
             {
-                const auto endpointsItem=new QTreeWidgetItem{QStringList{
-                                            iface.endpoints.empty() ? tr("Endpoints (%1)").arg(iface.numEPs) : tr("Endpoints")}};
-                ifaceItem->addChild(endpointsItem);
-                endpointsItem->setExpanded(true);
-                for(const auto& ep : iface.endpoints)
+                const auto epItem=new QTreeWidgetItem{QStringList{tr("Endpoint 0x%1").arg(ep.address, 2, 16, QLatin1Char('0'))}};
+                endpointsItem->addChild(epItem);
+                epItem->setExpanded(true);
+                epItem->addChild(new QTreeWidgetItem{QStringList{tr("Direction"), formatDirection(ep)}});
+                const auto attribItem=new QTreeWidgetItem{QStringList{tr("Attributes"),
+                                                                      QString("0x%1").arg(ep.attributes, 2, 16, QLatin1Char('0'))}};
+                epItem->addChild(attribItem);
                 {
-                    const auto epItem=new QTreeWidgetItem{QStringList{tr("Endpoint 0x%1").arg(ep.address, 2, 16, QLatin1Char('0'))}};
-                    endpointsItem->addChild(epItem);
-                    epItem->setExpanded(true);
-                    epItem->addChild(new QTreeWidgetItem{QStringList{tr("Direction"),
-                                                                     ep.direction=="in"  ? tr("In")   :
-                                                                     ep.direction=="out" ? tr("Out")  :
-                                                                     ep.direction=="both"? tr("Both") :
-                                                                     ep.direction}});
-                    const auto attribItem=new QTreeWidgetItem{QStringList{tr("Attributes"),
-                                                                          QString("0x%1").arg(ep.attributes, 2, 16, QLatin1Char('0'))}};
-                    epItem->addChild(attribItem);
+                    attribItem->addChild(new QTreeWidgetItem{QStringList{tr("Transfer type"), formatTransferType(ep)}});
+                    if(ep.type==DeviceInfo::Endpoint::Type::Isochronous)
                     {
-                        attribItem->addChild(new QTreeWidgetItem{QStringList{tr("Transfer type"),
-                                                                             ep.type=="Control"   ? tr("Control")     :
-                                                                             ep.type=="Isoc"      ? tr("Isochronous") :
-                                                                             ep.type=="Bulk"      ? tr("Bulk")        :
-                                                                             ep.type=="Interrupt" ? tr("Interrupt")   :
-                                                                             ep.type}});
-                        if(ep.type=="Isoc")
-                        {
-                            attribItem->addChild(new QTreeWidgetItem{QStringList{tr("Synchronization type"),
-                                                                     (ep.attributes&0xc)==0x0 ? tr("No synchronization") :
-                                                                     (ep.attributes&0xc)==0x4 ? tr("Asynchronous")       :
-                                                                     (ep.attributes&0xc)==0x8 ? tr("Adaptive")           :
-                                                                     (ep.attributes&0xc)==0xc ? tr("Synchronous")        :
-                                                                     "(my bug, please report)"}});
-                            attribItem->addChild(new QTreeWidgetItem{QStringList{tr("Usage type"),
-                                                                     (ep.attributes&0x30)==0x00 ? tr("Data")                    :
-                                                                     (ep.attributes&0x30)==0x10 ? tr("Feedback")                :
-                                                                     (ep.attributes&0x30)==0x20 ? tr("Explicit feedback data")  :
-                                                                     (ep.attributes&0x30)==0x30 ? tr("(Reserved value)")        :
-                                                                     "(my bug, please report)"}});
-                        }
+                        attribItem->addChild(new QTreeWidgetItem{QStringList{tr("Synchronization type"),
+                                                                 (ep.attributes&0xc)==0x0 ? tr("No synchronization") :
+                                                                 (ep.attributes&0xc)==0x4 ? tr("Asynchronous")       :
+                                                                 (ep.attributes&0xc)==0x8 ? tr("Adaptive")           :
+                                                                 (ep.attributes&0xc)==0xc ? tr("Synchronous")        :
+                                                                 "(my bug, please report)"}});
+                        attribItem->addChild(new QTreeWidgetItem{QStringList{tr("Usage type"),
+                                                                 (ep.attributes&0x30)==0x00 ? tr("Data")                    :
+                                                                 (ep.attributes&0x30)==0x10 ? tr("Feedback")                :
+                                                                 (ep.attributes&0x30)==0x20 ? tr("Explicit feedback data")  :
+                                                                 (ep.attributes&0x30)==0x30 ? tr("(Reserved value)")        :
+                                                                 "(my bug, please report)"}});
                     }
-                    epItem->addChild(new QTreeWidgetItem{QStringList{tr("Max packet size"), QString::number(ep.maxPacketSize)}});
-                    epItem->addChild(new QTreeWidgetItem{QStringList{tr("Interval between transfers"),
-                                            QString(u8"%1\u202f%2").arg(ep.intervalBetweenTransfers).arg(ep.intervalUnit)}});
                 }
+                epItem->addChild(new QTreeWidgetItem{QStringList{tr("Max packet size"), QString::number(ep.maxPacketSize)}});
+                epItem->addChild(new QTreeWidgetItem{QStringList{tr("Interval between transfers"), formatInterval(ep)}});
             }
         }
     }
+}
 
-    const auto rawDescriptorsItem=new QTreeWidgetItem{QStringList{tr("Raw descriptors")}};
-    addTopLevelItem(rawDescriptorsItem);
-    for(const auto& desc : device_->rawDescriptors)
+void PropertiesWidget::buildDocument(DocumentKey const& key)
+{
+    current_=std::make_shared<Document>(key, device_->snapshotId);
+
+    if(!device_->diagnostics.empty())
     {
-        QString name;
-        if(desc.size()<2)
-            name=tr("(broken)");
+        const auto problemsItem=new QTreeWidgetItem{QStringList{tr("Problems while reading"),
+                                                                tr("some properties may be missing or wrong")}};
+        addTopLevelItem(problemsItem);
+        for(const auto& message : device_->diagnostics)
+            problemsItem->addChild(new QTreeWidgetItem{QStringList{message}});
+        problemsItem->setExpanded(true);
+    }
+    forEachField(deviceFields, [this](auto const& field)
+    {
+        if(isShown(field, static_cast<DeviceInfo const&>(*device_)))
+            addTopLevelItem(new QTreeWidgetItem{QStringList{tr(field.label), formatField(field, static_cast<DeviceInfo const&>(*device_))}});
+    });
+    const auto configsItem=new QTreeWidgetItem{QStringList{tr("Configurations")}};
+    addTopLevelItem(configsItem);
+    configsItem->setExpanded(true);
+    std::shared_ptr<const DeviceInfo> info;
+    for(const auto& config : device_->configs())
+    {
+        const bool active=device_->isActive(config);
+        const auto configItem=new QTreeWidgetItem{QStringList{active ? tr("Configuration %1 (active)").arg(config.configNum)
+                                                                     : tr("Configuration %1").arg(config.configNum)}};
+        configsItem->addChild(configItem);
+        if(active)
+        {
+            configItem->setExpanded(true);
+            addConfigProperties(configItem, *device_, config);
+        }
         else
-            name=::name(static_cast<DescriptorType>(desc[1]));
-        const auto descItem=new QTreeWidgetItem{QStringList{name, formatBytes(desc, wantWrapRawDumps_)}};
-        descItem->setFont(1, monoFont);
-        rawDescriptorsItem->addChild(descItem);
+        {
+            // Only built if expanded, from a copy that doesn't depend on device_ staying alive
+            if(!info)
+                info=std::make_shared<const DeviceInfo>(*device_);
+            const auto index=&config-device_->configs().data();
+            setLazyChildren(configItem, [this, info, index](QTreeWidgetItem*const root)
+                            { addConfigProperties(root, *info, info->configs()[index]); });
+        }
     }
 
+    const auto rawDescriptorsItem=new QTreeWidgetItem{QStringList{tr("Raw descriptors")}};
+    addTopLevelItem(rawDescriptorsItem);
+    setBackgroundChildren(rawDescriptorsItem,
+                          [descriptors=device_->descriptors, wrap=wantWrapRawDumps_]
+                          {
+                              std::vector<ItemData> items;
+                              items.reserve(descriptors->rawDescriptors.size());
+                              for(const auto range : descriptors->rawDescriptors)
+                              {
+                                  const ByteView desc(descriptors->data.data()+range.offset, range.size);
+                                  QString name;
+                                  if(desc.size()<2)
+                                      name=tr("(broken)");
+                                  else
+                                      name=::name(static_cast<DescriptorType>(desc[1]));
+                                  items.push_back({QStringList{name, formatBytes(desc, wrap)}, 1, nullptr});
+                              }
+                              return items;
+                          });
+
 	QTreeWidgetItem* extToolOutputItem=nullptr;
     if(wantExtToolOutput_)
     {
@@ -1,18 +1,85 @@
 #pragma once
 
+#include <map>
+#include <list>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
 #include <QTreeWidget>
+#include "Device.h"
+#include "HIDReportDescriptor.h"
 
-struct Device;
 class PropertiesWidget : public QTreeWidget
 {
     bool wantExtToolOutput_=false;
     bool wantWrapRawDumps_=false;
     Device const* device_=nullptr;
 
-    void updateTree();
+    // An item built off the GUI thread, where neither items nor fonts may be made
+    struct ItemData
+    {
+        QStringList columns;
+        int monospaceColumn=-1;
+        std::shared_ptr<const HIDDescriptorRows> hidRows;
+    };
+    // Adds the children of an item on the GUI thread
+    using ChildrenBuilder=std::function<void(QTreeWidgetItem*)>;
+    // Runs in the background, so must not touch the widget nor the device
+    using ItemDataBuilder=std::function<std::vector<ItemData>()>;
+    // One of the builders is set
+    struct LazyChildren
+    {
+        ChildrenBuilder build;
+        ItemDataBuilder buildInBackground;
+    };
+
+    struct DocumentKey
+    {
+        UniqueDeviceAddress address;
+        bool wrapRawDumps;
+        bool extToolOutput;
+        bool operator<(DocumentKey const& other) const;
+    };
+    // The items shown for a device. They're kept while other devices are shown,
+    // so that coming back to a device doesn't build them again.
+    struct Document
+    {
+        DocumentKey key;
+        uint64_t snapshotId;
+        std::unordered_map<QTreeWidgetItem*, LazyChildren> lazyChildren;
+        // Owned by the document while it isn't shown
+        std::vector<QTreeWidgetItem*> items;
+        std::vector<QTreeWidgetItem*> expandedItems;
+        // Counted when stashed, as an estimate of the memory taken
+        std::size_t itemCount=0;
+
+        Document(DocumentKey const& key, uint64_t snapshotId) : key(key), snapshotId(snapshotId) {}
+        ~Document();
+    };
+    std::shared_ptr<Document> current_;
+    // Most recently shown first
+    std::list<std::shared_ptr<Document>> cachedDocuments_;
+    std::map<DocumentKey, std::list<std::shared_ptr<Document>>::iterator> cachedDocumentIndex_;
+    std::size_t cachedItemCount_=0;
+    // In items, which is what memory use grows with: one device may have a dozen, another thousands
+    unsigned cacheCapacity_=20000;
+
+    void setLazyChildren(QTreeWidgetItem* item, ChildrenBuilder build);
+    void setBackgroundChildren(QTreeWidgetItem* item, ItemDataBuilder build);
+    void onItemExpanded(QTreeWidgetItem* item);
+    void adoptChildren(QTreeWidgetItem* item, std::vector<ItemData> const& children);
+    void addConfigProperties(QTreeWidgetItem* configItem, DeviceInfo const& dev, DeviceInfo::Config const& config);
+    void stashCurrentDocument();
+    std::shared_ptr<Document> takeCachedDocument(DocumentKey const& key);
+    void evictDocuments();
+    void restoreDocument(std::shared_ptr<Document> doc);
+    void buildDocument(DocumentKey const& key);
 public:
     PropertiesWidget(QWidget* parent=nullptr);
     void showDevice(Device const* dev);
     void setShowExtToolOutput(bool enable);
     void setWrapRawDumps(bool enable);
+    // How many items to keep of the properties of devices shown earlier
+    void setCacheCapacity(unsigned items);
 };
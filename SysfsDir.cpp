@@ -0,0 +1,290 @@
+#include "SysfsDir.h"
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "util.hpp"
+#ifdef USBVIEW_IO_URING
+# include "IoUring.h"
+#endif
+
+std::atomic<unsigned long> SysfsDir::syscallCount_{0};
+
+SysfsDir::SysfsDir(const int fd, std::string path)
+    : fd_(fd)
+    , path_(std::move(path))
+{
+}
+
+std::optional<SysfsDir> SysfsDir::tryOpen(std::filesystem::path const& path)
+{
+    const int fd=open(path.c_str(), O_PATH|O_DIRECTORY|O_CLOEXEC);
+    ++syscallCount_;
+    if(fd<0)
+        return std::nullopt;
+    return SysfsDir(fd, path.string());
+}
+
+std::optional<SysfsDir> SysfsDir::tryOpen(SysfsDir const& parent, std::string const& name)
+{
+    const int fd=openat(parent.fd_, name.c_str(), O_PATH|O_DIRECTORY|O_CLOEXEC);
+    ++syscallCount_;
+    if(fd<0)
+        return std::nullopt;
+    SysfsDir dir(fd, parent.path_+"/"+name);
+    dir.diagnostics_=parent.diagnostics_;
+    return dir;
+}
+
+SysfsDir::SysfsDir(SysfsDir&& other) noexcept
+    : fd_(other.fd_)
+    , path_(std::move(other.path_))
+    , prefetched_(std::move(other.prefetched_))
+    , diagnostics_(other.diagnostics_)
+{
+    other.fd_=-1;
+}
+
+SysfsDir::~SysfsDir()
+{
+    if(fd_<0) return;
+    close(fd_);
+    ++syscallCount_;
+}
+
+void SysfsDir::reportReadError(const char*const name, const int error) const
+{
+    // Reads without diagnostics are probes, e.g. of cache validity, whose failures will be seen again
+    if(!diagnostics_) return;
+    ++diagnosticCounters.missingAttributes;
+    if(error==ENOENT)
+        diagnostics_->push_back(QString("Missing attribute \"%1/%2\"").arg(path_.c_str(), name));
+    else
+        diagnostics_->push_back(QString("Failed to read \"%1/%2\": %3").arg(path_.c_str(), name, std::strerror(error)));
+}
+
+void SysfsDir::reportParseFailure(const char*const name, const char*const what) const
+{
+    if(!diagnostics_) return;
+    ++diagnosticCounters.parseFailures;
+    diagnostics_->push_back(QString("Failed to parse %1 from \"%2/%3\"").arg(what, path_.c_str(), name));
+}
+
+// Returns the number of bytes read, or npos with the error code if it fails
+std::size_t SysfsDir::read(const char*const name, char*const buf, const std::size_t size, int& error) const
+{
+    for(const auto& attr : prefetched_)
+    {
+        if(std::strcmp(attr.name, name)!=0) continue;
+        if(attr.error)
+        {
+            error=attr.error;
+            return std::string_view::npos;
+        }
+        return attr.data.copy(buf, size);
+    }
+
+    const int fd=openat(fd_, name, O_RDONLY|O_CLOEXEC);
+    ++syscallCount_;
+    if(fd<0)
+    {
+        error=errno;
+        return std::string_view::npos;
+    }
+    // sysfs text attributes are at most a page long and are always read in one go
+    const auto count=pread(fd, buf, size, 0);
+    const auto readErrno=errno;
+    close(fd);
+    syscallCount_+=2;
+    if(count<0)
+    {
+        error=readErrno;
+        return std::string_view::npos;
+    }
+    return count;
+}
+
+std::optional<std::string_view> SysfsDir::readLine(const char*const name, char*const buf, const std::size_t size) const
+{
+    int error=0;
+    const auto count=read(name, buf, size, error);
+    if(count==std::string_view::npos)
+    {
+        reportReadError(name, error);
+        return std::nullopt;
+    }
+    std::string_view line(buf, count);
+    if(!line.empty() && line.back()=='\n')
+        line.remove_suffix(1);
+    return line;
+}
+
+unsigned SysfsDir::getUInt(const char*const name, const int base) const
+{
+    char buf[64];
+    const auto line=readLine(name, buf, sizeof buf);
+    if(!line) return 0;
+    const auto value=parseUInt(*line, base);
+    if(!value)
+    {
+        reportParseFailure(name, "integer");
+        return 0;
+    }
+    return *value;
+}
+
+double SysfsDir::getDouble(const char*const name) const
+{
+    char buf[64];
+    const auto line=readLine(name, buf, sizeof buf);
+    if(!line) return 0;
+    const auto value=parseDouble(*line);
+    if(!value)
+    {
+        reportParseFailure(name, "floating-point number");
+        return 0;
+    }
+    return *value;
+}
+
+QString SysfsDir::getString(const char*const name) const
+{
+    char buf[4097];
+    const auto line=readLine(name, buf, sizeof buf);
+    if(!line) return {};
+    return QLatin1String(line->data(), line->size());
+}
+
+QString SysfsDir::getOptionalString(const char*const name) const
+{
+    char buf[4097];
+    int error=0;
+    auto count=read(name, buf, sizeof buf, error);
+    if(count==std::string_view::npos)
+    {
+        if(error!=ENOENT)
+            reportReadError(name, error);
+        return QString();
+    }
+    if(count && buf[count-1]=='\n')
+        --count;
+    return QLatin1String(buf, count);
+}
+
+InternedString SysfsDir::getInterned(const char*const name) const
+{
+    char buf[4097];
+    const auto line=readLine(name, buf, sizeof buf);
+    if(!line) return {};
+    return InternedString(*line);
+}
+
+InternedString SysfsDir::getOptionalInterned(const char*const name) const
+{
+    char buf[4097];
+    int error=0;
+    auto count=read(name, buf, sizeof buf, error);
+    if(count==std::string_view::npos)
+    {
+        if(error!=ENOENT)
+            reportReadError(name, error);
+        return {};
+    }
+    if(count && buf[count-1]=='\n')
+        --count;
+    return InternedString(std::string_view(buf, count));
+}
+
+std::vector<uint8_t> SysfsDir::getData(const char*const name) const
+{
+    std::vector<uint8_t> data;
+    appendData(name, data);
+    return data;
+}
+
+bool SysfsDir::appendData(const char*const name, std::vector<uint8_t>& data) const
+{
+    for(const auto& attr : prefetched_)
+    {
+        // A full page may be just the beginning, then the attribute is read again below, as are failed reads
+        if(std::strcmp(attr.name, name)!=0 || attr.error || attr.data.size()>=4096) continue;
+        data.insert(data.end(), attr.data.begin(), attr.data.end());
+        return true;
+    }
+
+    const int fd=openat(fd_, name, O_RDONLY|O_CLOEXEC);
+    ++syscallCount_;
+    if(fd<0)
+    {
+        reportReadError(name, errno);
+        return false;
+    }
+    // Binary attributes may be larger than a page, and their st_size is only an upper bound.
+    // The data is read straight into the end of the buffer.
+    const auto start=data.size();
+    bool ok=true;
+    for(;;)
+    {
+        constexpr std::size_t chunk=4096;
+        data.resize(data.size()+chunk);
+        const auto count=pread(fd, data.data()+data.size()-chunk, chunk, data.size()-chunk-start);
+        ++syscallCount_;
+        if(count<0)
+        {
+            reportReadError(name, errno);
+            data.resize(start);
+            ok=false;
+            break;
+        }
+        data.resize(data.size()-chunk+count);
+        if(count==0) break;
+    }
+    close(fd);
+    ++syscallCount_;
+    return ok;
+}
+
+std::string SysfsDir::linkTargetName(const char*const name) const
+{
+    char buf[4096];
+    const auto size=readlinkat(fd_, name, buf, sizeof buf);
+    ++syscallCount_;
+    if(size<0)
+        return {};
+    const std::string_view target(buf, size);
+    const auto slash=target.find_last_of('/');
+    return std::string(slash==target.npos ? target : target.substr(slash+1));
+}
+
+void SysfsBatch::add(SysfsDir& dir, const char*const*const names, const std::size_t count)
+{
+    for(std::size_t n=0; n<count; ++n)
+    {
+        const auto name=names[n];
+        // Already fetched by an earlier batch
+        if(std::any_of(dir.prefetched_.begin(), dir.prefetched_.end(),
+                       [name](auto const& attr){ return std::strcmp(attr.name, name)==0; }))
+            continue;
+        requests_.emplace_back(&dir, name);
+    }
+}
+
+void SysfsBatch::fetch()
+{
+#ifdef USBVIEW_IO_URING
+    std::vector<AttributeRead> reads;
+    reads.reserve(requests_.size());
+    for(const auto& [dir, name] : requests_)
+        reads.push_back({dir->fd_, name, 0, {}});
+    unsigned long syscalls=0;
+    const bool done=ioUringReadAttributes(reads, syscalls);
+    SysfsDir::syscallCount_+=syscalls;
+    if(done)
+    {
+        for(unsigned n=0; n<reads.size(); ++n)
+            requests_[n].first->prefetched_.push_back({reads[n].name, reads[n].error, std::move(reads[n].data)});
+    }
+#endif
+    requests_.clear();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <optional>
+#include <vector>
+#include <initializer_list>
+#include <filesystem>
+#include <string_view>
+#include <QString>
+#include "Diagnostics.hpp"
+#include "InternedString.h"
+
+// An open sysfs directory, whose attributes are read relative to it with
+// openat()+pread() into stack buffers. Each attribute costs three syscalls,
+// a missing optional one costs a single failed openat().
+// The getters don't throw: if an attribute can't be read or parsed, they
+// return an empty value and report the problem to the diagnostics, if set.
+class SysfsDir
+{
+    struct Prefetched
+    {
+        const char* name;
+        int error;
+        std::string data;
+    };
+
+    int fd_=-1;
+    std::string path_;
+    std::vector<Prefetched> prefetched_;
+    Diagnostics* diagnostics_=nullptr;
+
+    friend class SysfsBatch;
+
+    SysfsDir(int fd, std::string path);
+
+    std::size_t read(const char* name, char* buf, std::size_t size, int& error) const;
+    std::optional<std::string_view> readLine(const char* name, char* buf, std::size_t size) const;
+    void reportReadError(const char* name, int error) const;
+    void reportParseFailure(const char* name, const char* what) const;
+public:
+    // These return nullopt if the directory doesn't exist or can't be opened. A subdirectory
+    // reports to the same diagnostics as its parent.
+    static std::optional<SysfsDir> tryOpen(std::filesystem::path const& path);
+    static std::optional<SysfsDir> tryOpen(SysfsDir const& parent, std::string const& name);
+    SysfsDir(SysfsDir&& other) noexcept;
+    SysfsDir(SysfsDir const&)=delete;
+    SysfsDir& operator=(SysfsDir const&)=delete;
+    ~SysfsDir();
+
+    std::string const& path() const { return path_; }
+    void reportTo(Diagnostics& diagnostics) { diagnostics_=&diagnostics; }
+
+    unsigned getUInt(const char* name, int base) const;
+    double getDouble(const char* name) const;
+    QString getString(const char* name) const;
+    // Returns a null string without reporting if the attribute doesn't exist, and an
+    // empty one if it's empty, like bConfigurationValue of an unconfigured device
+    QString getOptionalString(const char* name) const;
+    // The same as UTF-8, without going through QString
+    InternedString getInterned(const char* name) const;
+    InternedString getOptionalInterned(const char* name) const;
+    std::vector<uint8_t> getData(const char* name) const;
+    // Appends the contents to data, which is left as it was on failure
+    bool appendData(const char* name, std::vector<uint8_t>& data) const;
+    // Returns the file name of the symlink target, or an empty string if there's no such symlink
+    std::string linkTargetName(const char* name) const;
+
+    // Number of syscalls issued by all SysfsDir instances so far
+    static unsigned long syscallCount() { return syscallCount_; }
+private:
+    static std::atomic<unsigned long> syscallCount_;
+};
+
+// Collects attribute reads from many directories, e.g. all the siblings on one
+// level of the tree, to do them in one io_uring batch. If io_uring is
+// unavailable, fetch() does nothing, and the attributes are read on demand.
+class SysfsBatch
+{
+    std::vector<std::pair<SysfsDir*, const char*>> requests_;
+public:
+    // The names must outlive the SysfsDir
+    void add(SysfsDir& dir, std::initializer_list<const char*> names) { add(dir, names.begin(), names.size()); }
+    void add(SysfsDir& dir, const char*const* names, std::size_t count);
+    void fetch();
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Components of a directory name under /sys/bus/usb/devices, parsed in a single pass.
+// The grammar follows linux-4.14.157/drivers/usb/core/{usb.c,message.c,endpoint.c}
+// and drivers/hid/hid-core.c:
+//   usbB                  root hub of bus B
+//   B-P.P.P               device on bus B behind the chain of ports P
+//   B-P.P.P:C.I           interface I of configuration C (root hubs use "B-0:C.I")
+//   ep_XX                 endpoint with hex address XX
+//   BBBB:VVVV:PPPP.NNNN   HID device with hex bus type, vendor and product ids, and instance number
+struct SysfsName
+{
+    enum Kind
+    {
+        OTHER,
+        ROOT_HUB,
+        DEVICE,
+        INTERFACE,
+        ENDPOINT,
+        HID_DEVICE,
+    };
+    // USB allows at most 7 tiers, i.e. 6 ports between the root hub and a device
+    static constexpr unsigned MAX_PORTS=6;
+
+    Kind kind=OTHER;
+    unsigned bus=0; // bus number, or HID bus type
+    std::array<uint8_t, MAX_PORTS> ports{};
+    unsigned portCount=0;
+    unsigned config=0;
+    unsigned iface=0;
+    unsigned endpointAddress=0;
+    unsigned vendorId=0;
+    unsigned productId=0;
+    unsigned hidInstance=0;
+
+    // Port of the parent hub the device is connected to, 0 for root hubs
+    constexpr unsigned port() const { return portCount ? ports[portCount-1] : 0; }
+};
+
+namespace sysfs_name_detail
+{
+
+constexpr int digitValue(const char c, const unsigned base)
+{
+    if('0'<=c && c<='9') return c-'0';
+    if(base==16 && 'A'<=c && c<='F') return c-'A'+10;
+    if(base==16 && 'a'<=c && c<='f') return c-'a'+10;
+    return -1;
+}
+
+// Parses a number at pos, advancing pos past it. Fails on an empty or overflowing number.
+constexpr bool parseNumber(std::string_view str, std::size_t& pos, unsigned& value, const unsigned base=10,
+                           const std::size_t exactDigits=0)
+{
+    const auto begin=pos;
+    value=0;
+    while(pos<str.size())
+    {
+        const int digit=digitValue(str[pos], base);
+        if(digit<0) break;
+        if(value > (0xffffffffu-digit)/base) return false;
+        value=value*base+digit;
+        ++pos;
+    }
+    if(exactDigits) return pos-begin==exactDigits;
+    return pos>begin;
+}
+
+constexpr bool consume(std::string_view str, std::size_t& pos, const char c)
+{
+    if(pos>=str.size() || str[pos]!=c) return false;
+    ++pos;
+    return true;
+}
+
+}
+
+constexpr SysfsName classifySysfsName(const std::string_view str)
+{
+    using namespace sysfs_name_detail;
+    SysfsName name;
+    std::size_t pos=0;
+
+    if(str.substr(0,3)=="usb")
+    {
+        pos=3;
+        if(parseNumber(str, pos, name.bus) && pos==str.size())
+            name.kind=SysfsName::ROOT_HUB;
+        return name;
+    }
+    if(str.substr(0,3)=="ep_")
+    {
+        pos=3;
+        if(parseNumber(str, pos, name.endpointAddress, 16, 2) && pos==str.size())
+            name.kind=SysfsName::ENDPOINT;
+        return name;
+    }
+
+    // Only four hex digits and a colon make it a HID device: "1-10:1.0" has a colon at the same place
+    if(parseNumber(str, pos, name.bus, 16, 4) && consume(str, pos, ':'))
+    {
+        if(parseNumber(str, pos, name.vendorId, 16, 4) && consume(str, pos, ':') &&
+           parseNumber(str, pos, name.productId, 16, 4) && consume(str, pos, '.') &&
+           parseNumber(str, pos, name.hidInstance, 16, 4) && pos==str.size())
+        {
+            name.kind=SysfsName::HID_DEVICE;
+        }
+        return name;
+    }
+
+    pos=0;
+    if(!parseNumber(str, pos, name.bus)) return name;
+    if(!consume(str, pos, '-')) return name;
+    do
+    {
+        unsigned port=0;
+        if(name.portCount==SysfsName::MAX_PORTS || !parseNumber(str, pos, port) || port>255) return name;
+        name.ports[name.portCount++]=port;
+    }
+    while(consume(str, pos, '.'));
+
+    if(pos==str.size())
+    {
+        // "B-0" is not a valid device name, only root hub interfaces use port 0
+        if(name.ports[0]!=0)
+            name.kind=SysfsName::DEVICE;
+        return name;
+    }
+    if(consume(str, pos, ':') && parseNumber(str, pos, name.config) && consume(str, pos, '.') &&
+       parseNumber(str, pos, name.iface) && pos==str.size())
+    {
+        name.kind=SysfsName::INTERFACE;
+    }
+    return name;
+}
+
+static_assert(classifySysfsName("usb3").kind==SysfsName::ROOT_HUB && classifySysfsName("usb3").bus==3);
+static_assert(classifySysfsName("1-4.2.3").kind==SysfsName::DEVICE && classifySysfsName("1-4.2.3").port()==3);
+static_assert(classifySysfsName("1-4.2:1.0").kind==SysfsName::INTERFACE && classifySysfsName("1-4.2:1.0").iface==0);
+static_assert(classifySysfsName("2-0:1.0").kind==SysfsName::INTERFACE);
+static_assert(classifySysfsName("1-10:1.0").kind==SysfsName::INTERFACE && classifySysfsName("1-10:1.0").port()==10);
+static_assert(classifySysfsName("10-1:1.0").kind==SysfsName::INTERFACE && classifySysfsName("10-1:1.0").bus==10);
+static_assert(classifySysfsName("10-1").kind==SysfsName::DEVICE && classifySysfsName("1-10").kind==SysfsName::DEVICE);
+static_assert(classifySysfsName("ep_81").kind==SysfsName::ENDPOINT && classifySysfsName("ep_81").endpointAddress==0x81);
+static_assert(classifySysfsName("0003:046D:C52B.0001").kind==SysfsName::HID_DEVICE &&
+              classifySysfsName("0003:046D:C52B.0001").productId==0xc52b);
+static_assert(classifySysfsName("001F:1234:ABCD.000A").kind==SysfsName::HID_DEVICE);
+static_assert(classifySysfsName("1-0").kind==SysfsName::OTHER && classifySysfsName("power").kind==SysfsName::OTHER &&
+              classifySysfsName("1-1:1").kind==SysfsName::OTHER && classifySysfsName("ep_8").kind==SysfsName::OTHER);
@@ -0,0 +1,73 @@
+#include "TaskGroup.h"
+#include <future>
+#include <exception>
+#include <QRunnable>
+#include <QThreadPool>
+
+class TaskGroup::Task : public QRunnable
+{
+    std::function<void()> func_;
+    std::promise<void> promise_;
+    std::future<void> future_;
+public:
+    explicit Task(std::function<void()> func)
+        : func_(std::move(func))
+        , future_(promise_.get_future())
+    {
+        setAutoDelete(false);
+    }
+    void run() override
+    {
+        try
+        {
+            func_();
+            promise_.set_value();
+        }
+        catch(...)
+        {
+            promise_.set_exception(std::current_exception());
+        }
+    }
+    void wait()
+    {
+        future_.get();
+    }
+};
+
+TaskGroup::TaskGroup() = default;
+
+TaskGroup::~TaskGroup()
+{
+    // The functions may refer to the caller's locals, so we mustn't let them outlive the group
+    try { wait(); }
+    catch(...) {}
+}
+
+void TaskGroup::run(std::function<void()> func)
+{
+    auto& task=tasks_.emplace_back(std::make_unique<Task>(std::move(func)));
+    QThreadPool::globalInstance()->start(task.get());
+}
+
+void TaskGroup::wait()
+{
+    const auto pool=QThreadPool::globalInstance();
+    std::exception_ptr firstError;
+    for(const auto& task : tasks_)
+    {
+        if(pool->tryTake(task.get()))
+            task->run();
+        try
+        {
+            task->wait();
+        }
+        catch(...)
+        {
+            if(!firstError)
+                firstError=std::current_exception();
+        }
+    }
+    tasks_.clear();
+    if(firstError)
+        std::rethrow_exception(firstError);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <functional>
+
+// A set of functions run on the global thread pool. Waiting on the group
+// doesn't just block: tasks that no pool thread has picked up yet are taken
+// back and run in the waiting thread, so nested groups (e.g. one per hub
+// subtree) can't starve the pool.
+class TaskGroup
+{
+    class Task;
+    std::vector<std::unique_ptr<Task>> tasks_;
+public:
+    TaskGroup();
+    ~TaskGroup();
+    TaskGroup(TaskGroup const&)=delete;
+    TaskGroup& operator=(TaskGroup const&)=delete;
+
+    void run(std::function<void()> func);
+    // Waits for all the tasks to finish, then rethrows the first exception thrown by any of them
+    void wait();
+};
@@ -0,0 +1,210 @@
+#include "UdevDeviceTree.h"
+#include <map>
+#include <climits>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include <libudev.h>
+#include "SysfsDir.h"
+#include "DescriptorCache.h"
+#include "SysfsName.hpp"
+#include "util.hpp"
+
+namespace
+{
+
+template<typename T, T* (*unref)(T*)>
+struct UdevUnref
+{
+    void operator()(T* object) const { unref(object); }
+};
+using UdevPtr=std::unique_ptr<udev, UdevUnref<udev, udev_unref>>;
+using UdevDevicePtr=std::unique_ptr<udev_device, UdevUnref<udev_device, udev_device_unref>>;
+using UdevEnumeratePtr=std::unique_ptr<udev_enumerate, UdevUnref<udev_enumerate, udev_enumerate_unref>>;
+
+std::string parentSyspath(udev_device*const dev, const char*const devtype)
+{
+    // The parent belongs to the child, it's not to be unref'ed
+    const auto parent=udev_device_get_parent_with_subsystem_devtype(dev, "usb", devtype);
+    return parent ? udev_device_get_syspath(parent) : "";
+}
+
+// Adds the device with its descendants, in the order of childPaths
+void addSubtree(DeviceGraph& graph, std::map<std::string, Device>& devices,
+                std::map<std::string, std::vector<std::string>> const& childPaths,
+                std::string const& syspath, const DeviceGraph::Index parent)
+{
+    const auto index=graph.add(std::move(devices.at(syspath)), parent);
+    const auto it=childPaths.find(syspath);
+    if(it==childPaths.end()) return;
+    for(const auto& childPath : it->second)
+        addSubtree(graph, devices, childPaths, childPath, index);
+}
+
+// The sysfs backend keeps the children in the order of the parent's directory, and so do we
+void sortInDirectoryOrder(std::string const& parentPath, std::vector<std::string>& children)
+{
+    std::map<std::string, unsigned> positions;
+    std::error_code ec;
+    for(std::filesystem::directory_iterator it(parentPath, ec), end; !ec && it!=end; it.increment(ec))
+        positions.emplace(it->path().string(), positions.size());
+    const auto position=[&positions](std::string const& path)
+    {
+        const auto it=positions.find(path);
+        return it==positions.end() ? UINT_MAX : it->second;
+    };
+    std::stable_sort(children.begin(), children.end(),
+                     [&position](auto const& path1, auto const& path2){ return position(path1) < position(path2); });
+}
+
+// What the sysfs backend takes the report descriptor from: a BUS_USB HID device
+// with the vendor and product of the USB device, right in the interface directory
+bool isOwnHIDDevice(udev_device*const hid, std::string const& interfacePath)
+{
+    const std::string syspath=udev_device_get_syspath(hid);
+    const auto slash=syspath.rfind('/');
+    if(syspath.compare(0, slash, interfacePath)!=0 || slash!=interfacePath.size())
+        return false;
+    const auto name=classifySysfsName(std::string_view(syspath).substr(slash+1));
+    if(name.kind!=SysfsName::HID_DEVICE || name.bus!=0x0003)
+        return false;
+    const auto usbDevice=udev_device_get_parent_with_subsystem_devtype(hid, "usb", "usb_device");
+    const auto id=[usbDevice](const char* name) -> std::optional<unsigned>
+    {
+        const auto value = usbDevice ? udev_device_get_sysattr_value(usbDevice, name) : nullptr;
+        if(!value) return std::nullopt;
+        return parseUInt(value, 16);
+    };
+    return id("idVendor")==name.vendorId && id("idProduct")==name.productId;
+}
+
+}
+
+std::vector<std::string> listUdevRootHubs()
+{
+    const UdevPtr udev(udev_new());
+    if(!udev) return {};
+    const UdevEnumeratePtr enumerate(udev_enumerate_new(udev.get()));
+    udev_enumerate_add_match_subsystem(enumerate.get(), "usb");
+    udev_enumerate_scan_devices(enumerate.get());
+
+    std::vector<std::string> rootHubs;
+    udev_list_entry* entry;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate.get()))
+    {
+        const std::string syspath=udev_list_entry_get_name(entry);
+        const auto slash=syspath.rfind('/');
+        if(classifySysfsName(std::string_view(syspath).substr(slash+1)).kind==SysfsName::ROOT_HUB)
+            rootHubs.push_back(syspath);
+    }
+    return rootHubs;
+}
+
+DeviceGraph readUdevSubtree(std::string const& sysfsPath)
+{
+    // A context per call, since libudev objects must not be shared between threads
+    const UdevPtr udev(udev_new());
+    if(!udev) return {};
+    const UdevDevicePtr root(udev_device_new_from_syspath(udev.get(), sysfsPath.c_str()));
+    if(!root)
+    {
+        ++diagnosticCounters.vanishedDevices;
+        return {};
+    }
+
+    // Everything below the root: USB devices and interfaces, and whatever the drivers have created under the interfaces
+    const UdevEnumeratePtr enumerate(udev_enumerate_new(udev.get()));
+    udev_enumerate_add_match_parent(enumerate.get(), root.get());
+    udev_enumerate_scan_devices(enumerate.get());
+
+    std::vector<UdevDevicePtr> usbDevices;
+    std::map<std::string, Device::InterfaceBinding> interfaces;
+    std::vector<UdevDevicePtr> others;
+    udev_list_entry* entry;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate.get()))
+    {
+        UdevDevicePtr dev(udev_device_new_from_syspath(udev.get(), udev_list_entry_get_name(entry)));
+        if(!dev) continue;
+        const auto subsystem=udev_device_get_subsystem(dev.get());
+        const auto devtype=udev_device_get_devtype(dev.get());
+        if(subsystem && devtype && std::string_view(subsystem)=="usb")
+        {
+            if(std::string_view(devtype)=="usb_device")
+            {
+                usbDevices.emplace_back(std::move(dev));
+            }
+            else if(std::string_view(devtype)=="usb_interface")
+            {
+                const auto attribute=[&dev](const char* name)
+                {
+                    const auto value=udev_device_get_sysattr_value(dev.get(), name);
+                    return value ? value : "";
+                };
+                auto& binding=interfaces[udev_device_get_syspath(dev.get())];
+                binding.ifaceNum=parseUInt(attribute("bInterfaceNumber"), 16).value_or(0);
+                binding.altSettingNum=parseUInt(attribute("bAlternateSetting"), 10).value_or(0);
+                binding.sysfsPath=udev_device_get_syspath(dev.get());
+                binding.driver=InternedString(udev_device_get_driver(dev.get()));
+            }
+            continue;
+        }
+        others.emplace_back(std::move(dev));
+    }
+
+    // Device nodes and HID report descriptors belong to the interface they were created under
+    for(const auto& dev : others)
+    {
+        const auto it=interfaces.find(parentSyspath(dev.get(), "usb_interface"));
+        if(it==interfaces.end()) continue;
+        auto& binding=it->second;
+        if(const auto devnode=udev_device_get_devnode(dev.get()))
+            binding.deviceNodes.emplace_back(devnode);
+        const auto subsystem=udev_device_get_subsystem(dev.get());
+        if(subsystem && std::string_view(subsystem)=="hid" && isOwnHIDDevice(dev.get(), it->first))
+        {
+            // Binary, so it can't be read as a sysattr
+            if(auto hidDir=SysfsDir::tryOpen(std::filesystem::path(udev_device_get_syspath(dev.get()))))
+            {
+                std::vector<uint8_t> data;
+                if(hidDir->appendData("report_descriptor", data))
+                    binding.hidReportDescriptors.emplace_back(internHIDReportDescriptor(std::move(data)));
+            }
+        }
+    }
+
+    std::map<std::string, std::vector<Device::InterfaceBinding>> bindingsByDevice;
+    for(auto& [syspath, binding] : interfaces)
+    {
+        std::sort(binding.deviceNodes.begin(), binding.deviceNodes.end());
+        const auto slash=syspath.rfind('/');
+        bindingsByDevice[syspath.substr(0, slash)].emplace_back(std::move(binding));
+    }
+
+    std::map<std::string, Device> devices;
+    for(const auto& dev : usbDevices)
+    {
+        const std::string syspath=udev_device_get_syspath(dev.get());
+        devices.try_emplace(syspath, dev.get(), std::move(bindingsByDevice[syspath]));
+    }
+
+    const std::string rootPath=udev_device_get_syspath(root.get());
+    if(!devices.count(rootPath))
+        return {};
+    // Devices whose parent hasn't been enumerated are left out
+    std::map<std::string, std::vector<std::string>> childPaths;
+    for(const auto& dev : usbDevices)
+    {
+        const std::string syspath=udev_device_get_syspath(dev.get());
+        if(syspath==rootPath) continue;
+        const auto parentPath=parentSyspath(dev.get(), "usb_device");
+        if(devices.count(parentPath))
+            childPaths[parentPath].push_back(syspath);
+    }
+    for(auto& [parentPath, children] : childPaths)
+        sortInDirectoryOrder(parentPath, children);
+
+    DeviceGraph graph;
+    graph.reserve(devices.size());
+    addSubtree(graph, devices, childPaths, rootPath, DeviceGraph::NONE);
+    return graph;
+}
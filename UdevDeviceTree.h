@@ -0,0 +1,15 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "DeviceGraph.h"
+
+// Enumeration backend on top of the udev database. The topology comes from
+// parent links of udev devices, and names, drivers and device nodes come
+// from udev properties instead of being looked up by hand.
+
+// Returns the canonical sysfs paths of the root hubs
+std::vector<std::string> listUdevRootHubs();
+// Returns an empty graph if there's no such device
+DeviceGraph readUdevSubtree(std::string const& sysfsPath);
@@ -3,17 +3,86 @@
 #include <iomanip>
 #include <iostream>
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QCommandLineParser>
 #include "DeviceTreeWidget.h"
 #include "PropertiesWidget.h"
 #include "MainWindow.h"
+#include "DeviceTree.h"
+#include "NameCache.h"
+#include "DeviceSchema.hpp"
 #include "util.hpp"
 
 int main(int argc, char** argv)
 try
 {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    // The name cache file is in the application's cache directory, which is
+    // named after the application. There's no QApplication to tell it yet.
+    QCoreApplication::setApplicationName("usbview-qt");
+    // Load the name databases while the GUI is being set up and the devices are read
+    NameCache::instance().warmUp();
+
     QApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption backendOption("backend", QObject::tr("Read devices with <backend>: sysfs (default) or udev."),
+                                           "backend", "sysfs");
+    parser.addOption(backendOption);
+    const QCommandLineOption benchmarkOption("benchmark", QObject::tr("Read the device tree <rounds> times with each backend, print the timings and exit."),
+                                             "rounds");
+    parser.addOption(benchmarkOption);
+    const QCommandLineOption startupBenchmarkOption("benchmark-startup", QObject::tr("Print the time from start to the first paint of the device tree and exit."));
+    parser.addOption(startupBenchmarkOption);
+    const QCommandLineOption propertiesCacheOption("properties-cache", QObject::tr("Keep up to <items> property rows of recently shown devices (default: 20000)."),
+                                                   "items", "20000");
+    parser.addOption(propertiesCacheOption);
+    const QCommandLineOption dumpOption("dump", QObject::tr("Print the properties of all devices as text and exit."));
+    parser.addOption(dumpOption);
+    parser.process(app);
+
+    const auto backend=parser.value(backendOption);
+    if(backend=="udev")
+        setEnumerationBackend(EnumerationBackend::Udev);
+    else if(backend!="sysfs")
+    {
+        std::cerr << "Unknown backend \"" << backend.toStdString() << "\"\n";
+        return 1;
+    }
+
+    if(parser.isSet(benchmarkOption))
+    {
+        bool ok=false;
+        const auto rounds=parser.value(benchmarkOption).toUInt(&ok);
+        if(!ok || !rounds)
+        {
+            std::cerr << "Bad number of rounds \"" << parser.value(benchmarkOption).toStdString() << "\"\n";
+            return 1;
+        }
+        benchmarkEnumerationBackends(rounds);
+        return 0;
+    }
+    if(parser.isSet(dumpOption))
+    {
+        const auto tree=readDeviceTree();
+        for(const auto rootHub : tree.children(DeviceGraph::NONE))
+            std::cout << dumpDevice(tree, rootHub).toStdString() << "\n";
+        return 0;
+    }
+
+    bool cacheSizeOk=false;
+    const auto propertiesCacheSize=parser.value(propertiesCacheOption).toUInt(&cacheSizeOk);
+    if(!cacheSizeOk)
+    {
+        std::cerr << "Bad number of items \"" << parser.value(propertiesCacheOption).toStdString() << "\"\n";
+        return 1;
+    }
+
     MainWindow mainWindow;
+    mainWindow.setPropertiesCacheCapacity(propertiesCacheSize);
+    mainWindow.timeFirstPaint(startupTimer, parser.isSet(startupBenchmarkOption));
     mainWindow.show();
 
     return app.exec();
@@ -1,6 +1,8 @@
 #include "usbids.h"
+#include <cstring>
 #include <iostream>
-#include <QFile>
+#include <algorithm>
+#include <string_view>
 #include <QFileInfo>
 #include "util.hpp"
 
@@ -20,6 +22,32 @@ bool areHexDigits(const char* chars, const unsigned count)
     return true;
 }
 
+// Same set as QByteArray::trimmed()
+bool isSpace(const char c)
+{
+    return c==' ' || c=='\t' || c=='\n' || c=='\v' || c=='\f' || c=='\r';
+}
+
+std::string_view trimmed(std::string_view str)
+{
+    while(!str.empty() && isSpace(str.front()))
+        str.remove_prefix(1);
+    while(!str.empty() && isSpace(str.back()))
+        str.remove_suffix(1);
+    return str;
+}
+
+// Sorts by id, keeping the last of duplicate entries like assignment to a map would
+template<typename Entry>
+void sortUnique(std::vector<Entry>& entries)
+{
+    std::stable_sort(entries.begin(), entries.end());
+    std::reverse(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(), [](Entry const& a, Entry const& b){ return a.id==b.id; }),
+                  entries.end());
+    std::reverse(entries.begin(), entries.end());
+}
+
 }
 
 USBIDS::USBIDS()
@@ -37,68 +65,95 @@ bool USBIDS::tryParse(QString const& path)
 
 bool USBIDS::parse(QString const& path)
 {
-    vendors.clear();
-    products.clear();
+    vendors_.clear();
+    products_.clear();
+    // Unmaps the previous file
+    file_.close();
+    data_=nullptr;
 
-    QFile file(path);
-    if(!file.open(QFile::ReadOnly))
+    file_.setFileName(path);
+    if(!file_.open(QFile::ReadOnly))
     {
         std::cerr << "Warning: failed to open \"" << path.toStdString() << "\"\n";
         return false;
     }
+    const auto size=std::size_t(file_.size());
+    if(size==0)
+        return true;
+    const auto mapped=file_.map(0, size);
+    if(!mapped)
+    {
+        std::cerr << "Warning: failed to map \"" << path.toStdString() << "\": " << file_.errorString().toStdString() << "\n";
+        return false;
+    }
+    data_=reinterpret_cast<const char*>(mapped);
+    const auto end=data_+size;
+
+    const auto addEntry=[this](std::vector<Entry>& entries, const uint32_t id, std::string_view name)
+    {
+        name=trimmed(name);
+        entries.push_back({id, uint32_t(name.data()-data_), uint32_t(name.size())});
+    };
 
     uint16_t prevVendorId=0;
-    for(unsigned lineNumber=1;; ++lineNumber)
+    bool stopped=false;
+    unsigned lineNumber=1;
+    for(auto pos=data_; pos<end && !stopped; ++lineNumber)
     {
-        const auto line=file.readLine();
-        if(line.trimmed().isEmpty())
-        {
-            if(file.atEnd())
-                break;
-            if(!file.error())
-                continue;
-            std::cerr << "Failed to read line " << lineNumber << " of \"" << path.toStdString()
-                      << "\": " << file.errorString().toStdString() << "\n";
-            return false;
-        }
+        // memchr is vectorized in any libc worth using
+        const auto newline=static_cast<const char*>(std::memchr(pos, '\n', end-pos));
+        const auto lineEnd = newline ? newline+1 : end;
+        const std::string_view line(pos, lineEnd-pos);
+        pos=lineEnd;
+
+        if(trimmed(line).empty())
+            continue;
         if(line[0]=='#')
             continue;
         if(line.size() < 7)
         {
-            std::cerr << path.toStdString() << ":" << lineNumber << ": too short line:\n" << line.data() << "\n";
+            std::cerr << path.toStdString() << ":" << lineNumber << ": too short line:\n" << line << "\n";
             std::cerr << "Stopping processing file\n";
+            sortUnique(vendors_);
+            sortUnique(products_);
             return false;
         }
         if(areHexDigits(line.data(), 4) && line[4]==' ' && line[5]==' ')
         {
-            const auto vendorId=getUInt(std::string(line.left(4).data(), 4), 16);
-            vendors[vendorId]=line.mid(6).trimmed();
+            const auto vendorId=*parseUInt(line.substr(0, 4), 16);
+            addEntry(vendors_, vendorId, line.substr(6));
             prevVendorId=vendorId;
             continue;
         }
         if(line[0]=='\t' && areHexDigits(line.data()+1, 4) && line[5]==' ' && line[6]==' ')
         {
-            const auto productId=getUInt(std::string(line.mid(1,4).data(), 4), 16);
-            products[uint32_t(prevVendorId)<<16 | productId]=line.mid(7).trimmed();
+            const auto productId=*parseUInt(line.substr(1, 4), 16);
+            addEntry(products_, uint32_t(prevVendorId)<<16 | productId, line.substr(7));
             continue;
         }
         // Assuming that all vendor and product descriptions are adjacent up to
         // empty lines & comments. Ignoring any following entries.
-        break;
+        stopped=true;
     }
+    // The file lists ids in order, so this is cheap
+    sortUnique(vendors_);
+    sortUnique(products_);
     return true;
 }
 
+QString USBIDS::name(std::vector<Entry> const& entries, const uint32_t id) const
+{
+    const auto it=std::lower_bound(entries.begin(), entries.end(), Entry{id, 0, 0});
+    if(it==entries.end() || it->id!=id) return {};
+    return QString::fromUtf8(data_+it->offset, it->size);
+}
+
 QString USBIDS::vendor(const uint16_t vendorId) const
 {
-    const auto it=vendors.find(vendorId);
-    if(it==vendors.end()) return {};
-    return it->second;
+    return name(vendors_, vendorId);
 }
 
 QString USBIDS::product(const uint16_t vendorId, const uint16_t productId) const
 {
-    const auto it=products.find(uint32_t(vendorId)<<16 | productId);
-    if(it==products.end()) return {};
-    return it->second;
+    return name(products_, uint32_t(vendorId)<<16 | productId);
 }
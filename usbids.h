@@ -1,17 +1,49 @@
 #pragma once
 
+#include <vector>
 #include <stdint.h>
-#include <unordered_map>
+#include <string_view>
+#include <QFile>
 #include <QString>
 
+// The usb.ids database, memory-mapped and indexed by id. Names stay in the
+// mapping and are only decoded when looked up.
 class USBIDS
 {
-    std::unordered_map<uint16_t, QString> vendors;
-    std::unordered_map<uint32_t, QString> products;
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t offset;
+        uint32_t size;
+        bool operator<(Entry const& other) const { return id < other.id; }
+    };
+
+    QFile file_;
+    const char* data_=nullptr;
+    std::vector<Entry> vendors_;
+    std::vector<Entry> products_;
+
     bool tryParse(QString const& path);
+    QString name(std::vector<Entry> const& entries, uint32_t id) const;
+    std::string_view utf8(Entry const& entry) const { return {data_+entry.offset, entry.size}; }
 public:
     USBIDS();
     bool parse(QString const& path);
     QString vendor(uint16_t vendorId) const;
     QString product(uint16_t vendorId, uint16_t productId) const;
+
+    // Call func(vendorId, utf8Name) for each vendor in id order
+    template<typename Func>
+    void forEachVendor(Func func) const
+    {
+        for(const auto& entry : vendors_)
+            func(uint16_t(entry.id), utf8(entry));
+    }
+    // Call func(vendorId, productId, utf8Name) for each product in id order
+    template<typename Func>
+    void forEachProduct(Func func) const
+    {
+        for(const auto& entry : products_)
+            func(uint16_t(entry.id>>16), uint16_t(entry.id), utf8(entry));
+    }
 };
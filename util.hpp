@@ -1,11 +1,11 @@
 #pragma once
 
+#include <cmath>
 #include <string>
-#include <fstream>
-#include <stdexcept>
-#include <filesystem>
+#include <cassert>
+#include <charconv>
+#include <optional>
 #include <string_view>
-#include <QString>
 
 #define DEFINE_EXPLICIT_BOOL(Type)          \
 struct Type                                 \
@@ -22,83 +22,47 @@ inline bool startsWith(std::string_view line, std::string_view beginning)
     return std::string_view(line.data(), beginning.size()) == beginning;
 }
 
-inline unsigned getUInt(std::filesystem::path const& filePath, const int base)
+inline std::string_view skipLeadingSpaces(std::string_view str)
 {
-    std::ifstream file(filePath);
-    if(!file)
-        throw std::invalid_argument("Failed to open file \""+filePath.string()+"\"");
-    switch(base)
-    {
-    case 16: file >> std::hex; break;
-    case 10: file >> std::dec; break;
-    case 8:  file >> std::oct; break;
-    default: assert(!"Invalid base");
-    }
-    unsigned value;
-    file >> value;
-    if(!file)
-        throw std::invalid_argument("Failed to parse integer from file \""+filePath.string()+"\"");
-    if(file.get()!='\n')
-        throw std::invalid_argument("Trailing characters after integer in file \""+filePath.string()+"\"");
-    return value;
+    while(!str.empty() && (str.front()==' ' || str.front()=='\t'))
+        str.remove_prefix(1);
+    return str;
 }
 
-inline unsigned getUInt(std::string const& str, const int base)
+inline std::optional<unsigned> parseUInt(std::string_view str, const int base)
 {
     assert(base==8 || base==10 || base==16);
-    std::size_t pos=0;
-    const auto value=std::stoul(str, &pos, base);
-    if(pos!=str.size())
-        throw std::invalid_argument("Trailing characters after integer \""+str+"\"");
+    str=skipLeadingSpaces(str);
+    unsigned value=0;
+    const auto end=str.data()+str.size();
+    const auto [ptr, error]=std::from_chars(str.data(), end, value, base);
+    if(error!=std::errc{} || ptr!=end)
+        return std::nullopt;
     return value;
 }
 
-inline double getDouble(std::filesystem::path const& filePath)
+// Parses a plain decimal number like "1.5", the only floating-point format sysfs uses.
+// Unlike strtod, this doesn't depend on the C locale.
+inline std::optional<double> parseDouble(std::string_view str)
 {
-    std::ifstream file(filePath);
-    if(!file)
-        throw std::invalid_argument("Failed to open file \""+filePath.string()+"\"");
-    double value;
-    file >> value;
-    if(!file)
-        throw std::invalid_argument("Failed to parse floating-point number from file \""+filePath.string()+"\"");
-    if(file.get()!='\n')
-        throw std::invalid_argument("Trailing characters after floating-point number in file \""+filePath.string()+"\"");
-    return value;
-}
-
-inline double getDouble(std::string const& str)
-{
-    std::size_t pos=0;
-    const auto value=std::stod(str, &pos);
-    if(pos!=str.size())
-        throw std::invalid_argument("Trailing characters after floating-point number \""+str+"\"");
+    str=skipLeadingSpaces(str);
+    const auto end=str.data()+str.size();
+    unsigned long long intPart=0;
+    auto [ptr, error]=std::from_chars(str.data(), end, intPart);
+    if(error!=std::errc{})
+        return std::nullopt;
+    double value=intPart;
+    if(ptr!=end && *ptr=='.')
+    {
+        const auto fracBegin=++ptr;
+        unsigned long long fracPart=0;
+        const auto [fracEnd, fracError]=std::from_chars(fracBegin, end, fracPart);
+        if(fracError!=std::errc{})
+            return std::nullopt;
+        value+=fracPart/std::pow(10., fracEnd-fracBegin);
+        ptr=fracEnd;
+    }
+    if(ptr!=end)
+        return std::nullopt;
     return value;
 }
-
-inline QString getString(std::filesystem::path const& filePath)
-{
-    char data[4097];
-    std::ifstream file(filePath);
-    if(!file)
-        throw std::invalid_argument("Failed to open file \""+filePath.string()+"\"");
-    file.read(data, sizeof data);
-    if(!file.gcount())
-        throw std::invalid_argument("Failed to read file \""+filePath.string()+"\"");
-    auto str=QLatin1String(data, file.gcount());
-    if(str.size() && str.back()=='\n')
-        str.chop(1);
-    return str;
-}
-
-inline std::vector<uint8_t> getFileData(std::filesystem::path const& filePath)
-{
-    char data[4097];
-    std::ifstream file(filePath);
-    if(!file)
-        throw std::invalid_argument("Failed to open file \""+filePath.string()+"\"");
-    file.read(data, sizeof data);
-    if(!file.gcount() && !file.eof())
-        throw std::invalid_argument("Failed to read file \""+filePath.string()+"\"");
-    return std::vector<uint8_t>(data, data+file.gcount());
-}